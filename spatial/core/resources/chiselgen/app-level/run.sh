@@ -19,7 +19,12 @@ export DRAM_DEBUG=$dbg_dram
 export DEBUG_REGS=$dbg_reg
 export VPD_ON=0
 export VCD_ON=0
-export DRAM_NUM_OUTSTANDING_BURSTS=-1  # -1 == infinite number of outstanding bursts
+export DRAM_NUM_OUTSTANDING_BURSTS=${DRAM_NUM_OUTSTANDING_BURSTS:-0}  # Coalescing cache lines (VCS: every stream, XSIM: sparse streams); 0 == no coalescing, -1 == unbounded
+export DRAM_TRACE=${DRAM_TRACE:-0}  # 1 == write a binary trace of every DRAM burst to trace_*.bin
+export DRAM_RESPONSES_PER_CYCLE=${DRAM_RESPONSES_PER_CYCLE:-2}  # Max DRAM responses per cycle (1 read + 1 write port)
+export DRAM_ARENA_SIZE_MB=${DRAM_ARENA_SIZE_MB:-4096}  # Device memory cap for MALLOC
+export DRAM_ARENA_HUGEPAGES=${DRAM_ARENA_HUGEPAGES:-1}  # 0 == 4 KB pages, 1 == transparent hugepages, 2 == hugetlbfs
+export DRAM_ARENA_PREFAULT=${DRAM_ARENA_PREFAULT:-0}  # 1 == touch the whole arena at startup
 export DRAMSIM_HOME=`pwd`/verilog/DRAMSim2
 export LD_LIBRARY_PATH=${DRAMSIM_HOME}:$LD_LIBRARY_PATH
 
@@ -27,6 +32,7 @@ export LD_LIBRARY_PATH=${DRAMSIM_HOME}:$LD_LIBRARY_PATH
 export N3XT_LOAD_DELAY=3
 export N3XT_STORE_DELAY=11
 export N3XT_NUM_CHANNELS=64
+export N3XT_CHANNEL_BYTES_PER_CYCLE=${N3XT_CHANNEL_BYTES_PER_CYCLE:-0}  # Per-channel bandwidth cap, 0 == unlimited
 
 ./Top $@ 2>&1 | tee sim.log
 if [[ "$USE_IDEAL_DRAM" = "1" ]]; then
@@ -19,14 +19,132 @@
 
 using namespace std;
 
+/**
+ * Maps the accelerator's 32-bit (small) address space onto host (big)
+ * buffers, one 4 KB page at a time.
+ * - Translation goes through a small direct-mapped TLB, backed by a flat
+ *   two-level radix page table (10 + 10 bits of page number), so getBig()
+ *   never searches a tree
+ * - Freed ranges go back to a free list that later allocations reuse
+ *   (first fit); adjacent free ranges are merged
+ */
 class AddrRemapper {
 public:
 
-  const uint32_t pageSize = 4096;  // Bytes
-  map<uint32_t, uint64_t> addrMap;
-  uint32_t nextAvailAddr = 4096; // Next available address
+  static const uint32_t pageBits = 12;
+  const uint32_t pageSize = 1 << pageBits;  // Bytes
+
+  struct Allocation {
+    uint64_t bigAddr;
+    size_t size;          // Bytes, as requested
+    uint32_t numPages;
+  };
+
+private:
+  static const uint32_t leafBits = 10;
+  static const uint32_t rootBits = 32 - pageBits - leafBits;
+  static const uint32_t tlbSize = 64;
+
+  // pageTable[vpn >> leafBits][vpn & leafMask] is the big address of page 'vpn', 0 == unmapped
+  uint64_t *pageTable[1 << rootBits];
+  const uint32_t leafMask = (1 << leafBits) - 1;
+
+  struct TLBEntry {
+    uint32_t vpn;       // invalidVPN == empty
+    uint64_t bigPage;
+  };
+  TLBEntry tlb[tlbSize];
+  const uint32_t invalidVPN = 0xFFFFFFFF;   // Page numbers are 20 bits, so this never matches
+
+  map<uint32_t, Allocation> allocations;  // Small base address -> allocation
+  map<uint32_t, uint32_t> freeList;       // Small base address -> number of free pages
+  uint64_t nextAvailAddr = 4096; // Next available address; addresses below it are allocated or on freeList
+
+  void setPage(uint32_t vpn, uint64_t bigPage) {
+    uint64_t *&leaf = pageTable[vpn >> leafBits];
+    if (leaf == NULL) {
+      leaf = new uint64_t[1 << leafBits];
+      memset(leaf, 0, sizeof(uint64_t) * (1 << leafBits));
+    }
+    leaf[vpn & leafMask] = bigPage;
+    TLBEntry &e = tlb[vpn % tlbSize];
+    if (e.vpn == vpn) e.vpn = invalidVPN;
+  }
+
+  uint64_t walk(uint32_t vpn) {
+    uint64_t *leaf = pageTable[vpn >> leafBits];
+    return (leaf == NULL) ? 0 : leaf[vpn & leafMask];
+  }
+
+  // Returns the small base address of 'numPages' free pages
+  uint32_t allocPages(uint32_t numPages) {
+    for (map<uint32_t, uint32_t>::iterator it = freeList.begin(); it != freeList.end(); it++) {
+      if (it->second >= numPages) {
+        uint32_t addr = it->first;
+        uint32_t remaining = it->second - numPages;
+        freeList.erase(it);
+        if (remaining > 0) {
+          freeList[addr + numPages * pageSize] = remaining;
+        }
+        return addr;
+      }
+    }
+    uint64_t addr = nextAvailAddr;
+    ASSERT(addr + (uint64_t)numPages * pageSize <= (1ULL << 32), "[AddrRemapper] Out of accelerator address space allocating %u pages (next available address %lx)\n", numPages, nextAvailAddr);
+    nextAvailAddr += (uint64_t)numPages * pageSize;
+    return (uint32_t)addr;
+  }
+
+  void freePages(uint32_t addr, uint32_t numPages) {
+    uint64_t end = addr + (uint64_t)numPages * pageSize;
+
+    // Merge with the following free range, then with the preceding one
+    map<uint32_t, uint32_t>::iterator next = freeList.lower_bound(addr);
+    if ((next != freeList.end()) && (next->first == end)) {
+      numPages += next->second;
+      end += (uint64_t)next->second * pageSize;
+      freeList.erase(next);
+    }
+    map<uint32_t, uint32_t>::iterator prev = freeList.lower_bound(addr);
+    if (prev != freeList.begin()) {
+      prev--;
+      if (prev->first + (uint64_t)prev->second * pageSize == addr) {
+        addr = prev->first;
+        numPages += prev->second;
+        freeList.erase(prev);
+      }
+    }
+
+    // A range at the top of the allocated space is returned to it instead
+    if (end == nextAvailAddr) {
+      nextAvailAddr = addr;
+    } else {
+      freeList[addr] = numPages;
+    }
+  }
+
+  // Page table entries and bookkeeping for an allocation at small address 'addr'
+  void mapPages(uint32_t addr, uint64_t ptr, size_t size, uint32_t sizeInPages) {
+    uint32_t vpn = addr >> pageBits;
+    for (uint32_t i = 0; i < sizeInPages; i++) {
+      setPage(vpn + i, ptr + pageSize * i);
+    }
+
+    Allocation a;
+    a.bigAddr = ptr;
+    a.size = size;
+    a.numPages = sizeInPages;
+    allocations[addr] = a;
+  }
+
+public:
 
   AddrRemapper() {
+    memset(pageTable, 0, sizeof(pageTable));
+    for (uint32_t i = 0; i < tlbSize; i++) {
+      tlb[i].vpn = invalidVPN;
+      tlb[i].bigPage = 0;
+    }
   }
 
   uint32_t getNumPages(size_t size) {
@@ -56,32 +174,91 @@ public:
   }
 
   uint32_t remap(uint64_t ptr, size_t size) {
-    uint32_t addr = nextAvailAddr;
     uint32_t sizeInPages = getNumPages(alignedSize(pageSize, size));
-    nextAvailAddr += sizeInPages * pageSize;
+    uint32_t addr = allocPages(sizeInPages);
+    mapPages(addr, ptr, size, sizeInPages);
+    return addr;
+  }
 
-    // Create entries in hashmap
-    for (uint32_t i = 0; i < sizeInPages; i++) {
-      uint32_t smallAddr = addr + pageSize * i;
-      uint64_t bigAddr = ptr + pageSize * i;
-      addrMap[smallAddr] = bigAddr;
+  /**
+   * Re-create an allocation at a known small address, when restoring a
+   * checkpoint. The address range must already be taken out of the free
+   * space, which loadFreeList() does.
+   */
+  void remapAt(uint32_t addr, uint64_t ptr, size_t size) {
+    mapPages(addr, ptr, size, getNumPages(alignedSize(pageSize, size)));
+  }
+
+  const map<uint32_t, Allocation>& liveAllocations() {
+    return allocations;
+  }
+
+  // Checkpoint: the free ranges and the top of the allocated space
+  bool saveFreeList(FILE *f) {
+    uint64_t header[2] = { nextAvailAddr, freeList.size() };
+    if (fwrite(header, sizeof(header), 1, f) != 1) return false;
+    for (map<uint32_t, uint32_t>::iterator it = freeList.begin(); it != freeList.end(); it++) {
+      uint32_t range[2] = { it->first, it->second };
+      if (fwrite(range, sizeof(range), 1, f) != 1) return false;
     }
-    return addr;
+    return true;
+  }
+
+  bool loadFreeList(FILE *f) {
+    uint64_t header[2];
+    if (fread(header, sizeof(header), 1, f) != 1) return false;
+    nextAvailAddr = header[0];
+    freeList.clear();
+    for (uint64_t i = 0; i < header[1]; i++) {
+      uint32_t range[2];
+      if (fread(range, sizeof(range), 1, f) != 1) return false;
+      freeList[range[0]] = range[1];
+    }
+    return true;
+  }
+
+  /**
+   * Release the allocation starting at 'smallAddr' and return its address
+   * range to the free list. Fills in the big address and size that were
+   * passed to remap(), so that the caller can release the host buffer.
+   * Returns false if 'smallAddr' is not the start of a live allocation.
+   */
+  bool unmap(uint32_t smallAddr, Allocation *freed) {
+    map<uint32_t, Allocation>::iterator it = allocations.find(smallAddr);
+    if (it == allocations.end()) {
+      return false;
+    }
+    *freed = it->second;
+    allocations.erase(it);
+
+    uint32_t vpn = smallAddr >> pageBits;
+    for (uint32_t i = 0; i < freed->numPages; i++) {
+      setPage(vpn + i, 0);
+    }
+    freePages(smallAddr, freed->numPages);
+    return true;
   }
 
   uint64_t getBig(uint64_t smallAddr) {
-    uint32_t pageBase = getPageBase((uint32_t)smallAddr);
+    uint32_t vpn = (uint32_t)smallAddr >> pageBits;
     uint32_t pageOffset = getPageOffset((uint32_t)smallAddr);
 
-    map<uint32_t, uint64_t>::iterator it = addrMap.find(pageBase);
-    if(it == addrMap.end()) {
-      EPRINTF("[AddrRemapper getBig] Address %x does not exist in addrMap!\n", (uint32_t)smallAddr);
-      terminateSim();
+    TLBEntry &e = tlb[vpn % tlbSize];
+    if (e.vpn != vpn) {
+      uint64_t bigPage = walk(vpn);
+      if (bigPage == 0) {
+        EPRINTF("[AddrRemapper getBig] Address %x does not exist in addrMap!\n", (uint32_t)smallAddr);
+        terminateSim();
+      }
+      e.vpn = vpn;
+      e.bigPage = bigPage;
     }
-    return it->second + pageOffset;
+    return e.bigPage + pageOffset;
   }
 
   ~AddrRemapper() {
-    addrMap.clear();
+    for (uint32_t i = 0; i < (1 << rootBits); i++) {
+      if (pageTable[i] != NULL) delete[] pageTable[i];
+    }
   }
 };
@@ -0,0 +1,76 @@
+#ifndef __CHECKPOINT_H
+#define __CHECKPOINT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <map>
+
+#include "simDefs.h"
+
+// Included by sim.cpp after DRAM.h, whose device memory and remapper it saves
+
+/**
+ * Quiesced checkpoints of simulated DRAM
+ * A checkpoint holds the device memory arena (allocator state and every
+ * non-zero page), the address remapper's allocations and free ranges, and
+ * the cycle it was taken at. It can only be taken when no DRAM request is
+ * queued or in flight, so that the request queues and addrToReqMap are
+ * empty, and DRAMSim2 has no transactions left. DRAMSim2's own timing
+ * state (open rows, refresh counters) is not saved: a restored run starts
+ * with idle, precharged banks, as after reset.
+ * The design's state is not part of the checkpoint either; checkpoints are
+ * meant to be taken between accelerator runs, typically once device memory
+ * has been loaded and before the design is started.
+ */
+
+// Returns false if DRAM is busy; asserts on I/O errors
+bool saveCheckpoint(const char *path) {
+  if (!dramQuiesced()) return false;
+
+  FILE *f = fopen(path, "wb");
+  ASSERT(f != NULL, "[SIM] Unable to create checkpoint %s: %s\n", path, strerror(errno));
+
+  const map<uint32_t, AddrRemapper::Allocation> &allocations = remapper->liveAllocations();
+  simCheckpointHeader header;
+  memcpy(header.magic, simCheckpointMagic, sizeof(header.magic));
+  header.cycles = numCycles;
+  header.numAllocations = allocations.size();
+  bool ok = (fwrite(&header, sizeof(header), 1, f) == 1);
+  for (map<uint32_t, AddrRemapper::Allocation>::const_iterator it = allocations.begin(); ok && (it != allocations.end()); it++) {
+    simCheckpointAllocation a;
+    a.addr = it->first;
+    a.offset = deviceMemory->offsetOf((void*)it->second.bigAddr);
+    a.size = it->second.size;
+    ok = (fwrite(&a, sizeof(a), 1, f) == 1);
+  }
+  ok = ok && remapper->saveFreeList(f) && deviceMemory->save(f);
+  ok = (fclose(f) == 0) && ok;
+  ASSERT(ok, "[SIM] Unable to write checkpoint %s: %s\n", path, strerror(errno));
+  EPRINTF("[SIM] Checkpoint at cycle %lu: %lu buffers, saved to %s\n", numCycles, header.numAllocations, path);
+  return true;
+}
+
+// Load a checkpoint into device memory that has not been allocated from yet; returns the checkpoint's cycle
+uint64_t loadCheckpoint(const char *path) {
+  ASSERT(remapper->liveAllocations().empty(), "[SIM] Checkpoints can only be restored before the first MALLOC\n");
+  FILE *f = fopen(path, "rb");
+  ASSERT(f != NULL, "[SIM] Unable to open checkpoint %s: %s\n", path, strerror(errno));
+
+  simCheckpointHeader header;
+  bool ok = (fread(&header, sizeof(header), 1, f) == 1);
+  ASSERT(ok && (memcmp(header.magic, simCheckpointMagic, sizeof(header.magic)) == 0), "[SIM] %s is not a checkpoint\n", path);
+  for (uint64_t i = 0; ok && (i < header.numAllocations); i++) {
+    simCheckpointAllocation a;
+    ok = (fread(&a, sizeof(a), 1, f) == 1);
+    if (ok) remapper->remapAt((uint32_t)a.addr, (uint64_t)deviceMemory->pointerAt(a.offset), a.size);
+  }
+  ok = ok && remapper->loadFreeList(f) && deviceMemory->load(f);
+  fclose(f);
+  ASSERT(ok, "[SIM] Unable to restore checkpoint %s: truncated, or larger than DRAM_ARENA_SIZE_MB\n", path);
+  EPRINTF("[SIM] Restored checkpoint %s from cycle %lu: %lu buffers\n", path, header.cycles, header.numAllocations);
+  return header.cycles;
+}
+
+#endif // __CHECKPOINT_H
@@ -16,11 +16,19 @@ using namespace std;
 
 #include "vc_hdrs.h"
 #include "svdpi_src.h"
+#include "simDefs.h"
 
 #include <AddrRemapper.h>
+#include <DeviceArena.h>
+#include <ObjectPool.h>
+#include <FlatHashMap.h>
+#include <DRAMTrace.h>
+#include <TimingWheel.h>
+#include <CoalescingCache.h>
 #include <DRAMSim.h>
 
 #define MAX_NUM_Q             128
+#define DUT_BURST_SIZE_BYTES  64    // The DUT's DRAM data path: 64 byte lanes and strobes, as are the DPI vectors in Top-harness.sv
 #define PAGE_SIZE_BYTES       4096
 #define PAGE_OFFSET           (__builtin_ctz(PAGE_SIZE_BYTES))
 #define PAGE_FRAME_NUM(addr)  (addr >> PAGE_OFFSET)
@@ -29,26 +37,55 @@ using namespace std;
 uint32_t N3XT_LOAD_DELAY = 3;
 uint32_t N3XT_STORE_DELAY = 11;
 uint32_t N3XT_NUM_CHANNELS = MAX_NUM_Q;
+uint32_t N3XT_CHANNEL_BYTES_PER_CYCLE = 0;  // Per-channel bandwidth cap, 0 == unlimited
 
 // Simulation constants
-FILE *traceFp = NULL;
+DRAMTraceWriter *traceWriter = NULL;  // NULL when DRAM_TRACE is off
 
 // DRAMSim2
 DRAMSim::MultiChannelMemorySystem *mem = NULL;
 bool useIdealDRAM = false;
 bool debug = false;
 AddrRemapper *remapper = NULL;
+DeviceArena *deviceMemory = NULL;  // Backs every MALLOC
 
 extern uint64_t numCycles;
-uint32_t wordSizeBytes = 1;
-uint32_t burstSizeBytes = 64;
-uint32_t burstSizeWords = burstSizeBytes / wordSizeBytes;
+// Burst geometry, fixed by the DUT's data path. Only how DRAMSim2 splits a
+// burst into transactions depends on the DRAMSim2 config (see initDRAM)
+const uint32_t wordSizeBytes = 1;
+const uint32_t burstSizeBytes = DUT_BURST_SIZE_BYTES;
+const uint32_t burstSizeWords = burstSizeBytes / wordSizeBytes;
+uint32_t dramSimTxPerBurst = 1;   // DRAMSim2 transactions per burst (burstSizeBytes / TRANSACTION_SIZE)
 
 uint64_t globalID = 0;
 
+// Pools backing per-burst payloads (wdata / wstrb) and DRAMCommand request arrays
+SlabAllocator *burstPool = NULL;
+SizeClassAllocator *reqArrayPool = NULL;
+
 class DRAMRequest;
 class WData;
 
+/**
+ * Ideal (N3XT) DRAM timing: every burst completes a fixed delay after it is
+ * scheduled, plus the time its channel needs to transfer it at
+ * N3XT_CHANNEL_BYTES_PER_CYCLE. Any number of bursts can be in flight per
+ * channel; completions are events on a timing wheel instead of per-cycle
+ * counters on each queue head.
+ */
+TimingWheel<DRAMRequest*> idealDRAMWheel(1024);
+vector<uint64_t> idealChannelFree;  // Per channel: time at which the channel is free, in 1/N3XT_CHANNEL_BYTES_PER_CYCLE cycles
+
+uint64_t idealDRAMCompletionCycle(uint64_t channel, uint32_t delay) {
+  if (N3XT_CHANNEL_BYTES_PER_CYCLE == 0) {
+    return numCycles + delay;
+  }
+  uint64_t bytesPerCycle = N3XT_CHANNEL_BYTES_PER_CYCLE;
+  uint64_t start = std::max(numCycles * bytesPerCycle, idealChannelFree[channel]);
+  idealChannelFree[channel] = start + burstSizeBytes;
+  return (idealChannelFree[channel] + bytesPerCycle - 1) / bytesPerCycle + delay;
+}
+
 typedef union DRAMTag {
   struct {
     unsigned int uid : 32;
@@ -61,10 +98,13 @@ typedef union DRAMTag {
  * DRAM Command received from the design
  * One object could potentially create multiple DRAMRequests
  */
-class DRAMCommand {
+class DRAMCommand : public PooledObject<DRAMCommand> {
 public:
+  static constexpr const char *poolName = "DRAMCommand";
+
   uint64_t addr;
   uint32_t size;
+  uint32_t numRetired;  // Number of requests already popped from dramRequestQ
   DRAMTag tag;
   uint64_t channelID;
   bool isWr;
@@ -75,12 +115,21 @@ public:
     size = sz;
     tag = t;
     isWr = wr;
+    numRetired = 0;
+    reqs = (DRAMRequest**) reqArrayPool->alloc(size * sizeof(DRAMRequest*));
   }
 
   bool hasCompleted(); // Method definition after 'DRAMRequest' class due to forward reference
 
+  // Called when one request of this command leaves dramRequestQ.
+  // Returns true when the whole command has been retired and can be deleted.
+  bool retire() {
+    numRetired++;
+    return (numRetired == size);
+  }
+
   ~DRAMCommand() {
-    if (reqs != NULL) free(reqs);
+    reqArrayPool->free(reqs, size * sizeof(DRAMRequest*));
   }
 };
 
@@ -88,22 +137,80 @@ public:
 // DRAM Request Queue
 std::deque<DRAMRequest*> dramRequestQ[MAX_NUM_Q];
 
-class WData {
+// Merges requests for a burst that is already in flight (sparse gathers / scatters)
+// into that burst's DRAM transaction. Applies to every stream, so it is off
+// (0 lines) unless DRAM_NUM_OUTSTANDING_BURSTS asks for it; -1 == unbounded.
+CoalescingCache<DRAMRequest*> coalescingCache(0);
+void pushDRAMRequestQ(int id, DRAMRequest *req);
+void completeDRAMRequest(DRAMRequest *req);
+void syncDRAM();
+
+/**
+ * Write strobes are kept packed, one bit per byte, in the same layout that
+ * DPI uses for packed bit vectors (svBitVecVal): byte i's strobe is bit i%8
+ * of strobe byte i/8 on a little-endian host
+ */
+bool strobeSet(const uint32_t *strb, int i) {
+  return (((const uint8_t*)strb)[i / 8] >> (i % 8)) & 1;
+}
+
+bool allStrobesSet(const uint32_t *strb, int numBytes) {
+  const uint8_t *strbBytes = (const uint8_t*)strb;
+  for (int b=0; b<numBytes/8; b++) {
+    if (strbBytes[b] != 0xFF) return false;
+  }
+  return true;
+}
+
+// strbByteMask[b] has byte i set to 0xFF iff bit i of b is set
+struct StrbByteMasks {
+  uint64_t mask[256];
+  StrbByteMasks() {
+    for (int b=0; b<256; b++) {
+      mask[b] = 0;
+      for (int i=0; i<8; i++) {
+        if ((b >> i) & 1) mask[b] |= 0xFFULL << (8*i);
+      }
+    }
+  }
+} strbByteMasks;
+
+/**
+ * Masked byte blend: dst[i] = src[i] for every byte i whose strobe is set.
+ * Works on 8 bytes at a time; numBytes must be a multiple of 8.
+ */
+void blendBurst(uint8_t *dst, const uint8_t *src, const uint32_t *strb, int numBytes) {
+  const uint8_t *strbBytes = (const uint8_t*)strb;
+  for (int offset=0; offset<numBytes; offset+=8) {
+    uint8_t bits = strbBytes[offset / 8];
+    if (bits == 0) continue;
+    uint64_t m = strbByteMasks.mask[bits];
+    uint64_t d, s;
+    memcpy(&d, dst + offset, 8);
+    memcpy(&s, src + offset, 8);
+    d = (d & ~m) | (s & m);
+    memcpy(dst + offset, &d, 8);
+  }
+}
+
+class WData : public PooledObject<WData> {
 public:
+  static constexpr const char *poolName = "WData";
+
   uint8_t *wdata = NULL;
-  uint8_t *wstrb = NULL;
+  uint32_t *wstrb = NULL;  // Packed, 1 bit per byte
 
   WData() {
-    wdata = NULL;
-    wstrb = NULL;
+    wdata = (uint8_t*) burstPool->alloc();
+    wstrb = (uint32_t*) burstPool->alloc();
   }
 
   void print() {
   }
 
   ~WData() {
-    if (wdata != NULL) free(wdata);
-    if (wstrb != NULL) free(wstrb);
+    burstPool->free(wdata);
+    burstPool->free(wstrb);
   }
 
 };
@@ -113,8 +220,10 @@ public:
  * The 'size' field reflects the size of the entire command of which
  * this request is part of (legacy, should be removed)
  */
-class DRAMRequest {
+class DRAMRequest : public PooledObject<DRAMRequest> {
 public:
+  static constexpr const char *poolName = "DRAMRequest";
+
   uint64_t id;
   uint64_t addr;
   uint64_t rawAddr;
@@ -122,11 +231,13 @@ public:
   uint32_t size;
   DRAMTag tag;
   uint64_t channelID;
+  int queueID = -1;  // dramRequestQ holding this request
   bool isWr;
   uint8_t *wdata = NULL;
+  uint32_t *wstrb = NULL;  // Bytes of wdata to write; NULL == all
   uint32_t delay;
-  uint32_t elapsed;
   uint64_t issued;
+  uint32_t numPendingTx;   // DRAMSim2 transactions of this burst still outstanding
   bool completed;
   DRAMCommand *cmd;
 
@@ -149,8 +260,8 @@ public:
       channelID = id % N3XT_NUM_CHANNELS;
     }
 
-    elapsed = 0;
     issued = issueCycle;
+    numPendingTx = dramSimTxPerBurst;
     completed = false;
     wdata = NULL;
   }
@@ -161,11 +272,14 @@ public:
 
   void schedule() {
     if (!useIdealDRAM) {
-      mem->addTransaction(isWr, addr, tag.tag);
+      // Bursts larger than TRANSACTION_SIZE are issued as several back-to-back transactions
+      syncDRAM();
+      for (uint32_t i = 0; i < dramSimTxPerBurst; i++) {
+        mem->addTransaction(isWr, addr + i * (burstSizeBytes / dramSimTxPerBurst), tag.tag);
+      }
       channelID = mem->findChannelNumber(addr);
     } else {
-      dramRequestQ[channelID].push_back(this);
-      ASSERT(channelID < MAX_NUM_Q, "channelID %d is greater than MAX_NUM_Q %u. Is N3XT_NUM_CHANNELS (%u) > MAX_NUM_Q (%u) ?\n", channelID, MAX_NUM_Q, MAX_NUM_Q, N3XT_NUM_CHANNELS);
+      idealDRAMWheel.schedule(this, idealDRAMCompletionCycle(channelID, delay));
     }
     if (debug) {
       EPRINTF("                  Issuing following command:");
@@ -174,8 +288,18 @@ public:
 
   }
 
+  // Write this request's data to memory; only strobed bytes are written
+  void commitWrite() {
+    if (wstrb == NULL) {
+      memcpy((void*)addr, wdata, burstSizeBytes);
+    } else {
+      blendBurst((uint8_t*)addr, wdata, wstrb, burstSizeBytes);
+    }
+  }
+
   ~DRAMRequest() {
-    if (wdata != NULL) free(wdata);
+    burstPool->free(wdata);
+    burstPool->free(wstrb);
   }
 };
 
@@ -190,16 +314,76 @@ bool DRAMCommand::hasCompleted() {
   return completed;
 }
 
+/**
+ * Bitmap over dramRequestQ of queues whose head request has completed, so
+ * that per-cycle work only visits queues that can respond instead of
+ * scanning all MAX_NUM_Q queues
+ */
+const int numQMaskWords = (MAX_NUM_Q + 63) / 64;
+uint64_t readyQMask[numQMaskWords] = {0};
+
+void setQMaskBit(uint64_t *mask, int id, bool value) {
+  if (value) {
+    mask[id / 64] |= 1ULL << (id % 64);
+  } else {
+    mask[id / 64] &= ~(1ULL << (id % 64));
+  }
+}
+
+// Recompute the ready bit for queue 'id' after its head changed
+void updateQReady(int id) {
+  setQMaskBit(readyQMask, id, (dramRequestQ[id].size() > 0) && dramRequestQ[id].front()->completed);
+}
+
+// Calls f(id) for every queue whose bit is set in 'mask', in increasing order of id
+template <class F>
+void forEachQ(uint64_t *mask, F f) {
+  for (int w = 0; w < numQMaskWords; w++) {
+    uint64_t bits = mask[w];
+    while (bits != 0) {
+      int b = __builtin_ctzll(bits);
+      bits &= bits - 1;
+      f(w * 64 + b);
+    }
+  }
+}
+
+void pushDRAMRequestQ(int id, DRAMRequest *req) {
+  req->queueID = id;
+  dramRequestQ[id].push_back(req);
+  updateQReady(id);
+}
+
+void completeDRAMRequest(DRAMRequest *req) {
+  req->completed = true;
+  if ((req->queueID >= 0) && (dramRequestQ[req->queueID].front() == req)) {
+    setQMaskBit(readyQMask, req->queueID, true);
+  }
+  // Requests merged into this one's transaction complete with it
+  coalescingCache.complete(req->addr, req->isWr, req, [](DRAMRequest *r) {
+    completeDRAMRequest(r);
+  });
+}
+
 
 struct AddrTag {
   uint64_t addr;
   DRAMTag tag;
 
+  AddrTag() {
+    addr = 0;
+    tag.tag = 0;
+  }
+
   AddrTag(uint64_t a, DRAMTag t) {
     addr = a;
     tag = t;
   }
 
+  uint64_t hash() const {
+    return mixHash64(addr, tag.tag);
+  }
+
   bool operator==(const AddrTag &o) const {
       return addr == o.addr && tag.tag == o.tag.tag;
   }
@@ -217,10 +401,97 @@ std::deque<WData*> wdataQ;
 std::deque<DRAMRequest*> wrequestQ;
 
 // Internal book-keeping data structures
-std::map<struct AddrTag, DRAMRequest*> addrToReqMap;
+FlatHashMap<struct AddrTag, DRAMRequest*> addrToReqMap(16384);
+
+/**
+ * Issue one burst to DRAMSim2 / the ideal DRAM, unless a transaction for the
+ * same burst and direction is already in flight, in which case 'req' is
+ * merged into it. Merged requests still respond, and writes still commit
+ * their own strobed bytes, in dramRequestQ order.
+ */
+void issueDRAMRequest(DRAMRequest *req) {
+  if (coalescingCache.capacity() != 0) {
+    CoalescingCache<DRAMRequest*>::Line *line = coalescingCache.find(req->addr, req->isWr);
+    if (line != NULL) {
+      DRAMRequest *leader = line->leader;
+      req->channelID = leader->channelID;
+      coalescingCache.merge(line, req);
+      if (debug) {
+        EPRINTF("                  Merged into in-flight request %lu:", leader->id);
+        req->print();
+      }
+      return;
+    }
+    coalescingCache.allocate(req->addr, req->isWr, req);
+  }
+
+  // Only DRAMSim2 reports completions through txComplete; entries added
+  // for the ideal DRAM would never be erased
+  if (!useIdealDRAM) {
+    for (uint32_t t = 0; t < dramSimTxPerBurst; t++) {
+      struct AddrTag at(req->addr + t * (burstSizeBytes / dramSimTxPerBurst), req->tag);
+      addrToReqMap.insert(at, req);
+    }
+  }
+  req->schedule();
+}
+
+// True when no DRAM request is queued, waiting for write data or in flight
+bool dramQuiesced() {
+  for (int i = 0; i < MAX_NUM_Q; i++) {
+    if (!dramRequestQ[i].empty()) return false;
+  }
+  return wrequestQ.empty() && addrToReqMap.empty() && (idealDRAMWheel.size() == 0) && coalescingCache.isEmpty();
+}
+
+/**
+ * DRAMSim2 idle fast-forward. While nothing is in flight and the ranks are
+ * powered down, DRAMSim2 updates only count down refresh timers and add up
+ * background energy, so updateDRAM() just counts them and syncDRAM() catches
+ * DRAMSim2 up in closed form before anything looks at it again (a new
+ * transaction, final stats). Results, stats and completion cycles are the
+ * same as with an update every cycle.
+ */
+uint64_t dramIdleBudget = 0;  // Updates that may still be skipped
+uint64_t dramIdleOwed = 0;    // Updates skipped so far, not yet applied
+
+void syncDRAM() {
+  if (dramIdleOwed > 0) {
+    mem->skipIdle(dramIdleOwed);
+    dramIdleOwed = 0;
+  }
+  dramIdleBudget = 0;
+}
+
+// One DRAMSim2 update, in place of mem->update()
+void updateDRAM() {
+  if (dramIdleBudget > 0) {
+    dramIdleBudget--;
+    dramIdleOwed++;
+    return;
+  }
+  syncDRAM();
+  mem->update();
+  if (addrToReqMap.empty()) {
+    dramIdleBudget = mem->cyclesUntilNextEvent();
+  }
+}
+
+void printPoolStats() {
+  EPRINTF("[DRAM] Live objects: %lu DRAMCommand, %lu DRAMRequest, %lu WData, %lu bursts, %lu request arrays\n",
+    DRAMCommand::pool().numLive, DRAMRequest::pool().numLive, WData::pool().numLive, burstPool->numLive, reqArrayPool->numLive());
+}
+
+void printPoolStatsVerbose() {
+  DRAMCommand::pool().printStats();
+  DRAMRequest::pool().printStats();
+  WData::pool().printStats();
+  burstPool->printStats();
+  reqArrayPool->printStats();
+}
 
 uint32_t getWordOffset(uint64_t addr) {
-  return (addr & (burstSizeBytes - 1)) >> 2;   // TODO: Use parameters above!
+  return (addr & (burstSizeBytes - 1)) / wordSizeBytes;
 }
 
 void printQueueStats(int id) {
@@ -242,113 +513,90 @@ void printQueueStats(int id) {
   }
 }
 
-void updateIdealDRAMQ(int id) {
-  if (dramRequestQ[id].size() > 0) {
-    DRAMRequest *req = dramRequestQ[id].front();
-
-    if (useIdealDRAM) {
-      req->elapsed++;
-      if (req->elapsed >= req->delay) {
-        req->completed = true;
-        if (debug) {
-          EPRINTF("[idealDRAM txComplete] addr = %p, tag = %lx, finished = %lu\n", (void*)req->addr, req->tag.uid, numCycles);
-        }
+/**
+ * Response ports: the DUT has independent read and write response channels,
+ * each of which can hold one poked response per cycle. popWhenReady[port] is
+ * the dramRequestQ whose head was poked on 'port' (to be popped when ready)
+ */
+enum DRAMRespPort { RESP_READ = 0, RESP_WRITE = 1, NUM_RESP_PORTS = 2 };
+int popWhenReady[NUM_RESP_PORTS] = {-1, -1};
+uint32_t respPerCycle = NUM_RESP_PORTS;   // Max responses poked per cycle across all ports
 
-      }
-    }
+// N3Xt logging info: one record per burst, written when the DUT takes its response
+void traceDRAMRequest(DRAMRequest *req) {
+  if (traceWriter != NULL) {
+    traceWriter->append(req->id, req->issued, req->smallAddr, numCycles - req->issued, burstSizeBytes, req->channelID, req->isWr ? TRACE_STORE : TRACE_LOAD);
   }
 }
 
-int popWhenReady = -1; // dramRequestQ from which response was poked (to be popped when ready)
-
 /**
  * DRAM Queue pop: Called from testbench when response ready & valid is high
- * Both read and write requests are in a single queue in the simulation
- * So both 'popDRAMReadQ' and 'popDRAMWriteQ' call the same internal function
- * The separation in the DPI API is for future-proofing when we truly support
- * independent read and write DRAM channel simulation
+ * on 'port'. Read and write requests share the dramRequestQs, but a queue is
+ * only ever pending on one port since only its head can be poked.
  */
-void popDRAMQ() {
-  ASSERT(popWhenReady != -1, "popWhenReady == -1! Popping before the first command was issued?\n");
-  ASSERT(popWhenReady < MAX_NUM_Q, "popWhenReady = %d which is greater than MAX_NUM_Q (%d)!\n", popWhenReady, MAX_NUM_Q);
+void popDRAMQ(int port) {
+  int q = popWhenReady[port];
+  ASSERT(q != -1, "popWhenReady[%d] == -1! Popping before the first command was issued?\n", port);
+  ASSERT(q < MAX_NUM_Q, "popWhenReady[%d] = %d which is greater than MAX_NUM_Q (%d)!\n", port, q, MAX_NUM_Q);
 
-  DRAMRequest *req = dramRequestQ[popWhenReady].front();
-  ASSERT(req->completed, "Request at the head of pop queue (%d) not completed!\n", popWhenReady);
-  ASSERT(req != NULL, "Request at head of pop queue (%d) is null!\n", req);
+  DRAMRequest *req = dramRequestQ[q].front();
+  ASSERT(req != NULL, "Request at head of pop queue (%d) is null!\n", q);
+  ASSERT(req->completed, "Request at the head of pop queue (%d) not completed!\n", q);
 
   if (req->isWr) { // Write request
-    ASSERT(req->cmd->hasCompleted(), "Write command at head of pop queue (%d) is not fully complete!\n", popWhenReady);
+    ASSERT(req->cmd->hasCompleted(), "Write command at head of pop queue (%d) is not fully complete!\n", q);
     DRAMCommand *cmd = req->cmd;
     DRAMRequest *front = req;
     // Do write data handling, then pop all requests belonging to finished cmd from FIFO
-    while ((dramRequestQ[popWhenReady].size() > 0) && (front->cmd == cmd)) {
-      uint8_t *front_wdata = front->wdata;
-      uint8_t *front_waddr = (uint8_t*) front->addr;
-      for (int i=0; i<burstSizeWords; i++) {
-        front_waddr[i] = front_wdata[i];
-      }
-      dramRequestQ[popWhenReady].pop_front();
+    while ((front != NULL) && (front->cmd == cmd)) {
+      front->commitWrite();
+      traceDRAMRequest(front);
+      dramRequestQ[q].pop_front();
       delete front;
-      front = dramRequestQ[popWhenReady].front();
+      front = (dramRequestQ[q].size() > 0) ? dramRequestQ[q].front() : NULL;
     }
     delete cmd;
 
   } else {  // Read request: Just pop
-    dramRequestQ[popWhenReady].pop_front();
-    // TODO: Uncommenting lines below is causing a segfault
-    // More cleaner garbage collection required, but isn't an immediate problem
-//          if (req->cmd->hasCompleted()) {
-//            delete req->cmd;
-//          }
+    traceDRAMRequest(req);
+    dramRequestQ[q].pop_front();
+    // Requests of a command can be interleaved with other commands in the queue,
+    // so the command is freed only after its last request has been retired
+    DRAMCommand *cmd = req->cmd;
     delete req;
+    if (cmd->retire()) {
+      delete cmd;
+    }
   }
+  updateQReady(q);
 
   // Reset popWhenReady
-  popWhenReady = -1;
+  popWhenReady[port] = -1;
 }
 
 void popDRAMReadQ() {
-  popDRAMQ();
+  popDRAMQ(RESP_READ);
 }
 
 void popDRAMWriteQ() {
-  popDRAMQ();
+  popDRAMQ(RESP_WRITE);
 }
 
-bool checkQAndRespond(int id) {
-  // If request at front has completed, pop and poke DRAM response
+bool checkQAndRespond(int id, int port) {
+  // If request at front has completed and belongs on 'port', poke DRAM response
   bool pokedResponse = false;
   if (dramRequestQ[id].size() > 0) {
     DRAMRequest *req = dramRequestQ[id].front();
 
-//    if (useIdealDRAM) {
-//      req->elapsed++;
-//      if (req->elapsed >= req->delay) {
-//        req->completed = true;
-//        if (debug) {
-//          EPRINTF("[idealDRAM txComplete] addr = %p, tag = %lx, finished = %lu\n", (void*)req->addr, req->tag, numCycles);
-//        }
-//      }
-//    }
-
-    if (req->completed) {
-      uint8_t rdata[64] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    if (req->completed && (req->isWr == (port == RESP_WRITE))) {
       bool pokeResponse = false;
 
       if (req->isWr) { // Write request: Update 1 burst-length bytes at *addr
-        uint8_t *wdata = req->wdata;
-        uint8_t *waddr = (uint8_t*) req->addr;
-        for (int i=0; i<burstSizeWords; i++) {
-          waddr[i] = wdata[i];
-        }
+        req->commitWrite();
         if (req->cmd->hasCompleted()) {
           pokeResponse = true;
         }
-      } else { // Read request: Read burst-length bytes at *addr
-        uint8_t *raddr = (uint8_t*) req->addr;
-        for (int i=0; i<burstSizeWords; i++) {
-          rdata[i] = raddr[i];
-        }
+      } else { // Read request: burst-length bytes at *addr are sent to the DUT
         pokeResponse = true;
       }
 
@@ -358,93 +606,10 @@ bool checkQAndRespond(int id) {
           req->print();
         }
 
-      // N3Xt logging info
-      fprintf(traceFp, "id: %lu\n", req->id);
-      fprintf(traceFp, "issue: %lu\n", req->issued);
-      if (req->isWr) {
-        fprintf(traceFp, "type: STORE\n");
-      } else {
-        fprintf(traceFp, "type: LOAD\n");
-      }
-      fprintf(traceFp, "delay: %d\n", numCycles - req->issued);
-      fprintf(traceFp, "addr: %lu\n", req->smallAddr);
-      fprintf(traceFp, "size: %u\n", burstSizeBytes);
-      fprintf(traceFp, "channel: %d\n", req->channelID);
-      fprintf(traceFp, "\n");
-
-
         if (req->isWr) {
           pokeDRAMWriteResponse(req->tag.uid, req->tag.streamId);
         } else {
-          pokeDRAMReadResponse(
-            req->tag.uid,
-            req->tag.streamId,
-            rdata[0],
-            rdata[1],
-            rdata[2],
-            rdata[3],
-            rdata[4],
-            rdata[5],
-            rdata[6],
-            rdata[7],
-            rdata[8],
-            rdata[9],
-            rdata[10],
-            rdata[11],
-            rdata[12],
-            rdata[13],
-            rdata[14],
-            rdata[15],
-            rdata[16],
-            rdata[17],
-            rdata[18],
-            rdata[19],
-            rdata[20],
-            rdata[21],
-            rdata[22],
-            rdata[23],
-            rdata[24],
-            rdata[25],
-            rdata[26],
-            rdata[27],
-            rdata[28],
-            rdata[29],
-            rdata[30],
-            rdata[31],
-            rdata[32],
-            rdata[33],
-            rdata[34],
-            rdata[35],
-            rdata[36],
-            rdata[37],
-            rdata[38],
-            rdata[39],
-            rdata[40],
-            rdata[41],
-            rdata[42],
-            rdata[43],
-            rdata[44],
-            rdata[45],
-            rdata[46],
-            rdata[47],
-            rdata[48],
-            rdata[49],
-            rdata[50],
-            rdata[51],
-            rdata[52],
-            rdata[53],
-            rdata[54],
-            rdata[55],
-            rdata[56],
-            rdata[57],
-            rdata[58],
-            rdata[59],
-            rdata[60],
-            rdata[61],
-            rdata[62],
-            rdata[63]
-
-          );
+          pokeDRAMReadResponse(req->tag.uid, req->tag.streamId, (const svBitVecVal*) req->addr);
         }
         pokedResponse = true;
       }
@@ -454,49 +619,47 @@ bool checkQAndRespond(int id) {
 }
 
 void checkAndSendDRAMResponse() {
-  // Check if DRAM is ready
-  // TODO: This logic is sketchy for two reasons
-  // 1. This checks ready first before asserting valid. This should not be the case; valid and ready must be independent
-  // 2. read and write ready signals are combined, so logic stalls if EITHER is not ready. This is quite clunky and doesn't
-  //    model real world cases
-  SV_BIT_PACKED_ARRAY(32, dramReadRespReady);
-  SV_BIT_PACKED_ARRAY(32, dramWriteRespReady);
-  getDRAMReadRespReady((svBitVec32*)&dramReadRespReady);
-  getDRAMWriteRespReady((svBitVec32*)&dramWriteRespReady);
-//  uint32_t readReady = (uint32_t)*dramReadRespReady;
-//  uint32_t writeReady = (uint32_t)*dramWriteRespReady;
-//  uint32_t ready = readReady & writeReady;
-//  if (ready > 0) {
-
+  // Responses are poked (valid asserted) independently of the DUT's ready signals;
+  // a poked response is re-poked every cycle until popDRAMReadQ / popDRAMWriteQ.
   if (debug) {
     if ((numCycles % 5000) == 0) {
       for (int i = 0; i < MAX_NUM_Q; i++) {
         printQueueStats(i);
       }
+      printPoolStats();
     }
   }
 
-  if (popWhenReady >= 0) { // A particular queue has already poked its response, call it again
-    ASSERT(checkQAndRespond(popWhenReady), "popWhenReady (%d) >= 0, but no response generated from queue %d\n", popWhenReady, popWhenReady);
-  } else {   // Iterate over all queues and respond to the first non-empty queue
-    if (useIdealDRAM) {
-      for (int i =0; i < MAX_NUM_Q; i++) {
-        updateIdealDRAMQ(i);
-      }
+  uint32_t numResponses = 0;
+  for (int port = 0; port < NUM_RESP_PORTS; port++) {
+    if (popWhenReady[port] >= 0) { // A particular queue has already poked its response, call it again
+      ASSERT(checkQAndRespond(popWhenReady[port], port), "popWhenReady[%d] (%d) >= 0, but no response generated from queue %d\n", port, popWhenReady[port], popWhenReady[port]);
+      numResponses++;
     }
+  }
 
-    for (int i =0; i < MAX_NUM_Q; i++) {
-      if (checkQAndRespond(i)) {
-        popWhenReady = i;
-        break;
+  if (useIdealDRAM) {
+    idealDRAMWheel.advance(numCycles, [](DRAMRequest *req) {
+      completeDRAMRequest(req);
+      if (debug) {
+        EPRINTF("[idealDRAM txComplete] addr = %p, tag = %lx, finished = %lu\n", (void*)req->addr, req->tag.uid, numCycles);
       }
-    }
+    });
+  }
+
+  // Fill free ports from queues whose head has completed, lowest queue first
+  if (numResponses < respPerCycle) {
+    forEachQ(readyQMask, [&numResponses](int i) {
+      if ((numResponses >= respPerCycle) || (i == popWhenReady[RESP_READ]) || (i == popWhenReady[RESP_WRITE])) return;
+      for (int port = 0; port < NUM_RESP_PORTS; port++) {
+        if ((popWhenReady[port] < 0) && checkQAndRespond(i, port)) {
+          popWhenReady[port] = i;
+          numResponses++;
+          break;
+        }
+      }
+    });
   }
-//  } else {
-//    if (debug) {
-//      EPRINTF("[SIM] dramResp not ready, numCycles = %ld\n", numCycles);
-//    }
-//  }
 }
 
 class DRAMCallbackMethods {
@@ -510,11 +673,14 @@ public:
 
     // Find transaction, mark it as done, remove entry from map
     struct AddrTag at(addr, cmdTag);
-    std::map<struct AddrTag, DRAMRequest*>::iterator it = addrToReqMap.find(at);
-    ASSERT(it != addrToReqMap.end(), "address/tag tuple (%lx, %lx) not found in addrToReqMap!", addr, cmdTag.tag);
-    DRAMRequest* req = it->second;
-    req->completed = true;
+    DRAMRequest **it = addrToReqMap.find(at);
+    ASSERT(it != NULL, "address/tag tuple (%lx, %lx) not found in addrToReqMap!", addr, cmdTag.tag);
+    DRAMRequest* req = *it;
     addrToReqMap.erase(at);
+    req->numPendingTx--;
+    if (req->numPendingTx == 0) {
+      completeDRAMRequest(req);
+    }
   }
 };
 
@@ -526,7 +692,7 @@ extern "C" {
       WData *data = wdataQ.front();
       wrequestQ.pop_front();
       wdataQ.pop_front();
-      int write_all = (data->wstrb[0] == 1 && data->wstrb[1] == 1 && data->wstrb[2] == 1 && data->wstrb[3] == 1 && data->wstrb[4] == 1 && data->wstrb[5] == 1 && data->wstrb[6] == 1 && data->wstrb[7] == 1 && data->wstrb[8] == 1 && data->wstrb[9] == 1 && data->wstrb[10] == 1 && data->wstrb[11] == 1 && data->wstrb[12] == 1 && data->wstrb[13] == 1 && data->wstrb[14] == 1 && data->wstrb[15] == 1 && data->wstrb[16] == 1 && data->wstrb[17] == 1 && data->wstrb[18] == 1 && data->wstrb[19] == 1 && data->wstrb[20] == 1 && data->wstrb[21] == 1 && data->wstrb[22] == 1 && data->wstrb[23] == 1 && data->wstrb[24] == 1 && data->wstrb[25] == 1 && data->wstrb[26] == 1 && data->wstrb[27] == 1 && data->wstrb[28] == 1 && data->wstrb[29] == 1 && data->wstrb[30] == 1 && data->wstrb[31] == 1 && data->wstrb[32] == 1 && data->wstrb[33] == 1 && data->wstrb[34] == 1 && data->wstrb[35] == 1 && data->wstrb[36] == 1 && data->wstrb[37] == 1 && data->wstrb[38] == 1 && data->wstrb[39] == 1 && data->wstrb[40] == 1 && data->wstrb[41] == 1 && data->wstrb[42] == 1 && data->wstrb[43] == 1 && data->wstrb[44] == 1 && data->wstrb[45] == 1 && data->wstrb[46] == 1 && data->wstrb[47] == 1 && data->wstrb[48] == 1 && data->wstrb[49] == 1 && data->wstrb[50] == 1 && data->wstrb[51] == 1 && data->wstrb[52] == 1 && data->wstrb[53] == 1 && data->wstrb[54] == 1 && data->wstrb[55] == 1 && data->wstrb[56] == 1 && data->wstrb[57] == 1 && data->wstrb[58] == 1 && data->wstrb[59] == 1 && data->wstrb[60] == 1 && data->wstrb[61] == 1 && data->wstrb[62] == 1 && data->wstrb[63] == 1);
+      bool write_all = allStrobesSet(data->wstrb, burstSizeBytes);
       if (debug) {
         EPRINTF("[Service W Request (wrequestQ: %d elements, wdataQ: %d elements remaining)]\n", wrequestQ.size(), wdataQ.size());
         req->print();
@@ -534,122 +700,33 @@ extern "C" {
 
       if (write_all) {
         if (debug) {
-          EPRINTF("[Servicing W Command (all channels on)]             %u %u %u %u\n", data->wdata[0], data->wdata[1], data->wdata[2], data->wdata[3]);
-          EPRINTF("                                                    %u %u %u %u\n", data->wdata[4], data->wdata[5], data->wdata[6], data->wdata[7]);
-          EPRINTF("                                                    %u %u %u %u\n", data->wdata[8], data->wdata[9], data->wdata[10], data->wdata[11]);
-          EPRINTF("                                                    %u %u %u %u\n", data->wdata[12], data->wdata[13], data->wdata[14], data->wdata[15]);
-          EPRINTF("                                                    %u %u %u %u\n", data->wdata[16], data->wdata[17], data->wdata[18], data->wdata[19]);
-          EPRINTF("                                                    %u %u %u %u\n", data->wdata[20], data->wdata[21], data->wdata[22], data->wdata[23]);
-          EPRINTF("                                                    %u %u %u %u\n", data->wdata[24], data->wdata[25], data->wdata[26], data->wdata[27]);
-          EPRINTF("                                                    %u %u %u %u\n", data->wdata[28], data->wdata[29], data->wdata[30], data->wdata[31]);
-          EPRINTF("                                                    %u %u %u %u\n", data->wdata[32], data->wdata[33], data->wdata[34], data->wdata[35]);
-          EPRINTF("                                                    %u %u %u %u\n", data->wdata[36], data->wdata[37], data->wdata[38], data->wdata[39]);
-          EPRINTF("                                                    %u %u %u %u\n", data->wdata[40], data->wdata[41], data->wdata[42], data->wdata[43]);
-          EPRINTF("                                                    %u %u %u %u\n", data->wdata[44], data->wdata[45], data->wdata[46], data->wdata[47]);
-          EPRINTF("                                                    %u %u %u %u\n", data->wdata[48], data->wdata[49], data->wdata[50], data->wdata[51]);
-          EPRINTF("                                                    %u %u %u %u\n", data->wdata[52], data->wdata[53], data->wdata[54], data->wdata[55]);
-          EPRINTF("                                                    %u %u %u %u\n", data->wdata[56], data->wdata[57], data->wdata[58], data->wdata[59]);
-          EPRINTF("                                                    %u %u %u %u\n", data->wdata[60], data->wdata[61], data->wdata[62], data->wdata[63]);
+          EPRINTF("[Servicing W Command (all channels on)]\n");
+          for (int i=0; i<burstSizeBytes; i+=4) {
+            EPRINTF("                                   %u %u %u %u\n", data->wdata[i], data->wdata[i+1], data->wdata[i+2], data->wdata[i+3]);
+          }
         }
+        // Hand the burst buffer over to the request, which returns it to burstPool
         req->wdata = data->wdata;
-        req->schedule();
+        data->wdata = NULL;
       } else {
-        // Start with burst data
-        uint8_t *wdata = (uint8_t*) malloc(burstSizeBytes);
-        uint8_t *raddr = (uint8_t*) req->addr;
-        for (int i=0; i<burstSizeWords; i++) {
-          wdata[i] = raddr[i];
-        }
-
+        // Strobed bytes are blended into memory when the write commits (DRAMRequest::commitWrite),
+        // not here, so that earlier writes to the same burst still in flight are not lost
         if (debug) {
-          EPRINTF("[Servicing W Command (Strobed) ]   %u -> %u (%d), %u -> %u (%d), %u -> %u (%d), %u -> %u (%d)\n", data->wdata[0],  wdata[0],  data->wstrb[0],  data->wdata[1],  wdata[1],  data->wstrb[1],  data->wdata[2],  wdata[2],  data->wstrb[2],   data->wdata[3],  wdata[3],  data->wstrb[3]);
-          EPRINTF("                                   %u -> %u (%d), %u -> %u (%d), %u -> %u (%d), %u -> %u (%d)\n", data->wdata[4],  wdata[4],  data->wstrb[4],  data->wdata[5],  wdata[5],  data->wstrb[5],  data->wdata[6],  wdata[6],  data->wstrb[6],   data->wdata[7],  wdata[7],  data->wstrb[7]);
-          EPRINTF("                                   %u -> %u (%d), %u -> %u (%d), %u -> %u (%d), %u -> %u (%d)\n", data->wdata[8],  wdata[8],  data->wstrb[8],  data->wdata[9],  wdata[9],  data->wstrb[9],  data->wdata[10], wdata[10], data->wstrb[10],  data->wdata[11], wdata[11], data->wstrb[11]);
-          EPRINTF("                                   %u -> %u (%d), %u -> %u (%d), %u -> %u (%d), %u -> %u (%d)\n", data->wdata[12], wdata[12], data->wstrb[12], data->wdata[13], wdata[13], data->wstrb[13], data->wdata[14], wdata[14], data->wstrb[14],  data->wdata[15], wdata[15], data->wstrb[15]);
-          EPRINTF("                                   %u -> %u (%d), %u -> %u (%d), %u -> %u (%d), %u -> %u (%d)\n", data->wdata[16], wdata[16], data->wstrb[16], data->wdata[17], wdata[17], data->wstrb[17], data->wdata[18], wdata[18], data->wstrb[18],  data->wdata[19], wdata[19], data->wstrb[19]);
-          EPRINTF("                                   %u -> %u (%d), %u -> %u (%d), %u -> %u (%d), %u -> %u (%d)\n", data->wdata[20], wdata[20], data->wstrb[20], data->wdata[21], wdata[21], data->wstrb[21], data->wdata[22], wdata[22], data->wstrb[22],  data->wdata[23], wdata[23], data->wstrb[23]);
-          EPRINTF("                                   %u -> %u (%d), %u -> %u (%d), %u -> %u (%d), %u -> %u (%d)\n", data->wdata[24], wdata[24], data->wstrb[24], data->wdata[25], wdata[25], data->wstrb[25], data->wdata[26], wdata[26], data->wstrb[26],  data->wdata[27], wdata[27], data->wstrb[27]);
-          EPRINTF("                                   %u -> %u (%d), %u -> %u (%d), %u -> %u (%d), %u -> %u (%d)\n", data->wdata[28], wdata[28], data->wstrb[28], data->wdata[29], wdata[29], data->wstrb[29], data->wdata[30], wdata[30], data->wstrb[30],  data->wdata[31], wdata[31], data->wstrb[31]);
-          EPRINTF("                                   %u -> %u (%d), %u -> %u (%d), %u -> %u (%d), %u -> %u (%d)\n", data->wdata[32], wdata[32], data->wstrb[32], data->wdata[33], wdata[33], data->wstrb[33], data->wdata[34], wdata[34], data->wstrb[34],  data->wdata[35], wdata[35], data->wstrb[35]);
-          EPRINTF("                                   %u -> %u (%d), %u -> %u (%d), %u -> %u (%d), %u -> %u (%d)\n", data->wdata[36], wdata[36], data->wstrb[36], data->wdata[37], wdata[37], data->wstrb[37], data->wdata[38], wdata[38], data->wstrb[38],  data->wdata[39], wdata[39], data->wstrb[39]);
-          EPRINTF("                                   %u -> %u (%d), %u -> %u (%d), %u -> %u (%d), %u -> %u (%d)\n", data->wdata[40], wdata[40], data->wstrb[40], data->wdata[41], wdata[41], data->wstrb[41], data->wdata[42], wdata[42], data->wstrb[42],  data->wdata[43], wdata[43], data->wstrb[43]);
-          EPRINTF("                                   %u -> %u (%d), %u -> %u (%d), %u -> %u (%d), %u -> %u (%d)\n", data->wdata[44], wdata[44], data->wstrb[44], data->wdata[45], wdata[45], data->wstrb[45], data->wdata[46], wdata[46], data->wstrb[46],  data->wdata[47], wdata[47], data->wstrb[47]);
-          EPRINTF("                                   %u -> %u (%d), %u -> %u (%d), %u -> %u (%d), %u -> %u (%d)\n", data->wdata[48], wdata[48], data->wstrb[48], data->wdata[49], wdata[49], data->wstrb[49], data->wdata[50], wdata[50], data->wstrb[50],  data->wdata[51], wdata[51], data->wstrb[51]);
-          EPRINTF("                                   %u -> %u (%d), %u -> %u (%d), %u -> %u (%d), %u -> %u (%d)\n", data->wdata[52], wdata[52], data->wstrb[52], data->wdata[53], wdata[53], data->wstrb[53], data->wdata[54], wdata[54], data->wstrb[54],  data->wdata[55], wdata[55], data->wstrb[55]);
-          EPRINTF("                                   %u -> %u (%d), %u -> %u (%d), %u -> %u (%d), %u -> %u (%d)\n", data->wdata[56], wdata[56], data->wstrb[56], data->wdata[57], wdata[57], data->wstrb[57], data->wdata[58], wdata[58], data->wstrb[58],  data->wdata[59], wdata[59], data->wstrb[59]);
-          EPRINTF("                                   %u -> %u (%d), %u -> %u (%d), %u -> %u (%d), %u -> %u (%d)\n", data->wdata[60], wdata[60], data->wstrb[60], data->wdata[61], wdata[61], data->wstrb[61], data->wdata[62], wdata[62], data->wstrb[62],  data->wdata[63], wdata[63], data->wstrb[63]);
+          uint8_t *cur = (uint8_t*)req->addr;
+          EPRINTF("[Servicing W Command (Strobed) ]\n");
+          for (int i=0; i<burstSizeBytes; i+=4) {
+            EPRINTF("                                   %u -> %u (%d), %u -> %u (%d), %u -> %u (%d), %u -> %u (%d)\n",
+                cur[i],   data->wdata[i],   strobeSet(data->wstrb, i),   cur[i+1], data->wdata[i+1], strobeSet(data->wstrb, i+1),
+                cur[i+2], data->wdata[i+2], strobeSet(data->wstrb, i+2), cur[i+3], data->wdata[i+3], strobeSet(data->wstrb, i+3));
+          }
         }
-
-        // Fill in accel wdata
-        if (data->wstrb[0]) wdata[0] = data->wdata[0];
-        if (data->wstrb[1]) wdata[1] = data->wdata[1];
-        if (data->wstrb[2]) wdata[2] = data->wdata[2];
-        if (data->wstrb[3]) wdata[3] = data->wdata[3];
-        if (data->wstrb[4]) wdata[4] = data->wdata[4];
-        if (data->wstrb[5]) wdata[5] = data->wdata[5];
-        if (data->wstrb[6]) wdata[6] = data->wdata[6];
-        if (data->wstrb[7]) wdata[7] = data->wdata[7];
-        if (data->wstrb[8]) wdata[8] = data->wdata[8];
-        if (data->wstrb[9]) wdata[9] = data->wdata[9];
-        if (data->wstrb[10]) wdata[10] = data->wdata[10];
-        if (data->wstrb[11]) wdata[11] = data->wdata[11];
-        if (data->wstrb[12]) wdata[12] = data->wdata[12];
-        if (data->wstrb[13]) wdata[13] = data->wdata[13];
-        if (data->wstrb[14]) wdata[14] = data->wdata[14];
-        if (data->wstrb[15]) wdata[15] = data->wdata[15];
-        if (data->wstrb[16]) wdata[16] = data->wdata[16];
-        if (data->wstrb[17]) wdata[17] = data->wdata[17];
-        if (data->wstrb[18]) wdata[18] = data->wdata[18];
-        if (data->wstrb[19]) wdata[19] = data->wdata[19];
-        if (data->wstrb[20]) wdata[20] = data->wdata[20];
-        if (data->wstrb[21]) wdata[21] = data->wdata[21];
-        if (data->wstrb[22]) wdata[22] = data->wdata[22];
-        if (data->wstrb[23]) wdata[23] = data->wdata[23];
-        if (data->wstrb[24]) wdata[24] = data->wdata[24];
-        if (data->wstrb[25]) wdata[25] = data->wdata[25];
-        if (data->wstrb[26]) wdata[26] = data->wdata[26];
-        if (data->wstrb[27]) wdata[27] = data->wdata[27];
-        if (data->wstrb[28]) wdata[28] = data->wdata[28];
-        if (data->wstrb[29]) wdata[29] = data->wdata[29];
-        if (data->wstrb[30]) wdata[30] = data->wdata[30];
-        if (data->wstrb[31]) wdata[31] = data->wdata[31];
-        if (data->wstrb[32]) wdata[32] = data->wdata[32];
-        if (data->wstrb[33]) wdata[33] = data->wdata[33];
-        if (data->wstrb[34]) wdata[34] = data->wdata[34];
-        if (data->wstrb[35]) wdata[35] = data->wdata[35];
-        if (data->wstrb[36]) wdata[36] = data->wdata[36];
-        if (data->wstrb[37]) wdata[37] = data->wdata[37];
-        if (data->wstrb[38]) wdata[38] = data->wdata[38];
-        if (data->wstrb[39]) wdata[39] = data->wdata[39];
-        if (data->wstrb[40]) wdata[40] = data->wdata[40];
-        if (data->wstrb[41]) wdata[41] = data->wdata[41];
-        if (data->wstrb[42]) wdata[42] = data->wdata[42];
-        if (data->wstrb[43]) wdata[43] = data->wdata[43];
-        if (data->wstrb[44]) wdata[44] = data->wdata[44];
-        if (data->wstrb[45]) wdata[45] = data->wdata[45];
-        if (data->wstrb[46]) wdata[46] = data->wdata[46];
-        if (data->wstrb[47]) wdata[47] = data->wdata[47];
-        if (data->wstrb[48]) wdata[48] = data->wdata[48];
-        if (data->wstrb[49]) wdata[49] = data->wdata[49];
-        if (data->wstrb[50]) wdata[50] = data->wdata[50];
-        if (data->wstrb[51]) wdata[51] = data->wdata[51];
-        if (data->wstrb[52]) wdata[52] = data->wdata[52];
-        if (data->wstrb[53]) wdata[53] = data->wdata[53];
-        if (data->wstrb[54]) wdata[54] = data->wdata[54];
-        if (data->wstrb[55]) wdata[55] = data->wdata[55];
-        if (data->wstrb[56]) wdata[56] = data->wdata[56];
-        if (data->wstrb[57]) wdata[57] = data->wdata[57];
-        if (data->wstrb[58]) wdata[58] = data->wdata[58];
-        if (data->wstrb[59]) wdata[59] = data->wdata[59];
-        if (data->wstrb[60]) wdata[60] = data->wdata[60];
-        if (data->wstrb[61]) wdata[61] = data->wdata[61];
-        if (data->wstrb[62]) wdata[62] = data->wdata[62];
-        if (data->wstrb[63]) wdata[63] = data->wdata[63];
-
-
-        req->wdata = wdata;
-        req->schedule();
+        req->wdata = data->wdata;
+        req->wstrb = data->wstrb;
+        data->wdata = NULL;
+        data->wstrb = NULL;
       }
+      delete data;
+      issueDRAMRequest(req);
     } else if (wdataQ.size() > 0 & wrequestQ.size() == 0) {
       if (debug) {
         EPRINTF("[WARN] WRequestQ empty or head is ~isWr but WDataQ is not empty!");
@@ -658,176 +735,34 @@ extern "C" {
 
   }
 
-  int sendWdataStrb(
+  /**
+   * One burst of write data from the DUT. 'wdata' and 'wstrb' are packed
+   * bit vectors with byte / strobe i in the i'th lowest bits, so on a
+   * little-endian host they are copied over as-is.
+   */
+  void sendWdataStrb(
     int dramCmdValid,
     int dramReadySeen,
-    int wdata0, int wdata1, int wdata2, int wdata3, int wdata4, int wdata5, int wdata6, int wdata7, int wdata8, int wdata9, int wdata10, int wdata11, int wdata12, int wdata13, int wdata14, int wdata15, int wdata16, int wdata17, int wdata18, int wdata19, int wdata20, int wdata21, int wdata22, int wdata23, int wdata24, int wdata25, int wdata26, int wdata27, int wdata28, int wdata29, int wdata30, int wdata31, int wdata32, int wdata33, int wdata34, int wdata35, int wdata36, int wdata37, int wdata38, int wdata39, int wdata40, int wdata41, int wdata42, int wdata43, int wdata44, int wdata45, int wdata46, int wdata47, int wdata48, int wdata49, int wdata50, int wdata51, int wdata52, int wdata53, int wdata54, int wdata55, int wdata56, int wdata57, int wdata58, int wdata59, int wdata60, int wdata61, int wdata62, int wdata63, int strb0,
-    int strb1, int strb2, int strb3, int strb4, int strb5, int strb6, int strb7, int strb8, int strb9, int strb10, int strb11, int strb12, int strb13, int strb14, int strb15, int strb16, int strb17, int strb18, int strb19, int strb20, int strb21, int strb22, int strb23, int strb24, int strb25, int strb26, int strb27, int strb28, int strb29, int strb30, int strb31, int strb32, int strb33, int strb34, int strb35, int strb36, int strb37, int strb38, int strb39, int strb40, int strb41, int strb42, int strb43, int strb44, int strb45, int strb46, int strb47, int strb48, int strb49, int strb50, int strb51, int strb52, int strb53, int strb54, int strb55, int strb56, int strb57, int strb58, int strb59, int strb60, int strb61, int strb62, int strb63
+    const svBitVecVal *wdata,
+    const svBitVecVal *wstrb
   ) {
 
-
     WData *data = new WData;
-    uint8_t *wdata = (uint8_t*) malloc(burstSizeBytes);
-    uint8_t *wstrb = (uint8_t*) malloc(burstSizeBytes);
-
-    // view addr as uint64_t without doing sign extension
-    wdata[0] = (*(uint8_t*)&wdata0);
-    wdata[1] = (*(uint8_t*)&wdata1);
-    wdata[2] = (*(uint8_t*)&wdata2);
-    wdata[3] = (*(uint8_t*)&wdata3);
-    wdata[4] = (*(uint8_t*)&wdata4);
-    wdata[5] = (*(uint8_t*)&wdata5);
-    wdata[6] = (*(uint8_t*)&wdata6);
-    wdata[7] = (*(uint8_t*)&wdata7);
-    wdata[8] = (*(uint8_t*)&wdata8);
-    wdata[9] = (*(uint8_t*)&wdata9);
-    wdata[10] = (*(uint8_t*)&wdata10);
-    wdata[11] = (*(uint8_t*)&wdata11);
-    wdata[12] = (*(uint8_t*)&wdata12);
-    wdata[13] = (*(uint8_t*)&wdata13);
-    wdata[14] = (*(uint8_t*)&wdata14);
-    wdata[15] = (*(uint8_t*)&wdata15);
-    wdata[16] = (*(uint8_t*)&wdata16);
-    wdata[17] = (*(uint8_t*)&wdata17);
-    wdata[18] = (*(uint8_t*)&wdata18);
-    wdata[19] = (*(uint8_t*)&wdata19);
-    wdata[20] = (*(uint8_t*)&wdata20);
-    wdata[21] = (*(uint8_t*)&wdata21);
-    wdata[22] = (*(uint8_t*)&wdata22);
-    wdata[23] = (*(uint8_t*)&wdata23);
-    wdata[24] = (*(uint8_t*)&wdata24);
-    wdata[25] = (*(uint8_t*)&wdata25);
-    wdata[26] = (*(uint8_t*)&wdata26);
-    wdata[27] = (*(uint8_t*)&wdata27);
-    wdata[28] = (*(uint8_t*)&wdata28);
-    wdata[29] = (*(uint8_t*)&wdata29);
-    wdata[30] = (*(uint8_t*)&wdata30);
-    wdata[31] = (*(uint8_t*)&wdata31);
-    wdata[32] = (*(uint8_t*)&wdata32);
-    wdata[33] = (*(uint8_t*)&wdata33);
-    wdata[34] = (*(uint8_t*)&wdata34);
-    wdata[35] = (*(uint8_t*)&wdata35);
-    wdata[36] = (*(uint8_t*)&wdata36);
-    wdata[37] = (*(uint8_t*)&wdata37);
-    wdata[38] = (*(uint8_t*)&wdata38);
-    wdata[39] = (*(uint8_t*)&wdata39);
-    wdata[40] = (*(uint8_t*)&wdata40);
-    wdata[41] = (*(uint8_t*)&wdata41);
-    wdata[42] = (*(uint8_t*)&wdata42);
-    wdata[43] = (*(uint8_t*)&wdata43);
-    wdata[44] = (*(uint8_t*)&wdata44);
-    wdata[45] = (*(uint8_t*)&wdata45);
-    wdata[46] = (*(uint8_t*)&wdata46);
-    wdata[47] = (*(uint8_t*)&wdata47);
-    wdata[48] = (*(uint8_t*)&wdata48);
-    wdata[49] = (*(uint8_t*)&wdata49);
-    wdata[50] = (*(uint8_t*)&wdata50);
-    wdata[51] = (*(uint8_t*)&wdata51);
-    wdata[52] = (*(uint8_t*)&wdata52);
-    wdata[53] = (*(uint8_t*)&wdata53);
-    wdata[54] = (*(uint8_t*)&wdata54);
-    wdata[55] = (*(uint8_t*)&wdata55);
-    wdata[56] = (*(uint8_t*)&wdata56);
-    wdata[57] = (*(uint8_t*)&wdata57);
-    wdata[58] = (*(uint8_t*)&wdata58);
-    wdata[59] = (*(uint8_t*)&wdata59);
-    wdata[60] = (*(uint8_t*)&wdata60);
-    wdata[61] = (*(uint8_t*)&wdata61);
-    wdata[62] = (*(uint8_t*)&wdata62);
-    wdata[63] = (*(uint8_t*)&wdata63);
-
-    wstrb[0] =  strb0;
-    wstrb[1] =  strb1;
-    wstrb[2] =  strb2;
-    wstrb[3] =  strb3;
-    wstrb[4] =  strb4;
-    wstrb[5] =  strb5;
-    wstrb[6] =  strb6;
-    wstrb[7] =  strb7;
-    wstrb[8] =  strb8;
-    wstrb[9] =  strb9;
-    wstrb[10] = strb10;
-    wstrb[11] = strb11;
-    wstrb[12] = strb12;
-    wstrb[13] = strb13;
-    wstrb[14] = strb14;
-    wstrb[15] = strb15;
-    wstrb[16] = strb16;
-    wstrb[17] = strb17;
-    wstrb[18] = strb18;
-    wstrb[19] = strb19;
-    wstrb[20] = strb20;
-    wstrb[21] = strb21;
-    wstrb[22] = strb22;
-    wstrb[23] = strb23;
-    wstrb[24] = strb24;
-    wstrb[25] = strb25;
-    wstrb[26] = strb26;
-    wstrb[27] = strb27;
-    wstrb[28] = strb28;
-    wstrb[29] = strb29;
-    wstrb[30] = strb30;
-    wstrb[31] = strb31;
-    wstrb[32] = strb32;
-    wstrb[33] = strb33;
-    wstrb[34] = strb34;
-    wstrb[35] = strb35;
-    wstrb[36] = strb36;
-    wstrb[37] = strb37;
-    wstrb[38] = strb38;
-    wstrb[39] = strb39;
-    wstrb[40] = strb40;
-    wstrb[41] = strb41;
-    wstrb[42] = strb42;
-    wstrb[43] = strb43;
-    wstrb[44] = strb44;
-    wstrb[45] = strb45;
-    wstrb[46] = strb46;
-    wstrb[47] = strb47;
-    wstrb[48] = strb48;
-    wstrb[49] = strb49;
-    wstrb[50] = strb50;
-    wstrb[51] = strb51;
-    wstrb[52] = strb52;
-    wstrb[53] = strb53;
-    wstrb[54] = strb54;
-    wstrb[55] = strb55;
-    wstrb[56] = strb56;
-    wstrb[57] = strb57;
-    wstrb[58] = strb58;
-    wstrb[59] = strb59;
-    wstrb[60] = strb60;
-    wstrb[61] = strb61;
-    wstrb[62] = strb62;
-    wstrb[63] = strb63;
-
-    data->wdata = wdata;
-    data->wstrb = wstrb;
+    memcpy(data->wdata, wdata, burstSizeBytes);
+    memcpy(data->wstrb, wstrb, burstSizeBytes / 8);
 
     if (debug) {
-      EPRINTF("[sendWdataStrb]              %u (%d), %u (%d), %u (%d), %u (%d)\n", wdata[0], strb0, wdata[1], strb1, wdata[2], strb2,  wdata[3], strb3);
-      EPRINTF("                             %u (%d), %u (%d), %u (%d), %u (%d)\n", wdata[4], strb4, wdata[5], strb5, wdata[6], strb6,  wdata[7], strb7);
-      EPRINTF("                             %u (%d), %u (%d), %u (%d), %u (%d)\n", wdata[8], strb8, wdata[9], strb9, wdata[10], strb10,  wdata[11], strb11);
-      EPRINTF("                             %u (%d), %u (%d), %u (%d), %u (%d)\n", wdata[12], strb12, wdata[13], strb13, wdata[14], strb14,  wdata[15], strb15);
-      EPRINTF("                             %u (%d), %u (%d), %u (%d), %u (%d)\n", wdata[16], strb16, wdata[17], strb17, wdata[18], strb18,  wdata[19], strb19);
-      EPRINTF("                             %u (%d), %u (%d), %u (%d), %u (%d)\n", wdata[20], strb20, wdata[21], strb21, wdata[22], strb22,  wdata[23], strb23);
-      EPRINTF("                             %u (%d), %u (%d), %u (%d), %u (%d)\n", wdata[24], strb24, wdata[25], strb25, wdata[26], strb26,  wdata[27], strb27);
-      EPRINTF("                             %u (%d), %u (%d), %u (%d), %u (%d)\n", wdata[28], strb28, wdata[29], strb29, wdata[30], strb30,  wdata[31], strb31);
-      EPRINTF("                             %u (%d), %u (%d), %u (%d), %u (%d)\n", wdata[32], strb32, wdata[33], strb33, wdata[34], strb34,  wdata[35], strb35);
-      EPRINTF("                             %u (%d), %u (%d), %u (%d), %u (%d)\n", wdata[36], strb36, wdata[37], strb37, wdata[38], strb38,  wdata[39], strb39);
-      EPRINTF("                             %u (%d), %u (%d), %u (%d), %u (%d)\n", wdata[40], strb40, wdata[41], strb41, wdata[42], strb42,  wdata[43], strb43);
-      EPRINTF("                             %u (%d), %u (%d), %u (%d), %u (%d)\n", wdata[44], strb44, wdata[45], strb45, wdata[46], strb46,  wdata[47], strb47);
-      EPRINTF("                             %u (%d), %u (%d), %u (%d), %u (%d)\n", wdata[48], strb48, wdata[49], strb49, wdata[50], strb50,  wdata[51], strb51);
-      EPRINTF("                             %u (%d), %u (%d), %u (%d), %u (%d)\n", wdata[52], strb52, wdata[53], strb53, wdata[54], strb54,  wdata[55], strb55);
-      EPRINTF("                             %u (%d), %u (%d), %u (%d), %u (%d)\n", wdata[56], strb56, wdata[57], strb57, wdata[58], strb58,  wdata[59], strb59);
-      EPRINTF("                             %u (%d), %u (%d), %u (%d), %u (%d)\n", wdata[60], strb60, wdata[61], strb61, wdata[62], strb62,  wdata[63], strb63);
+      EPRINTF("[sendWdataStrb]\n");
+      for (int i=0; i<burstSizeBytes; i+=4) {
+        EPRINTF("                             %u (%d), %u (%d), %u (%d), %u (%d)\n",
+            data->wdata[i],   strobeSet(data->wstrb, i),   data->wdata[i+1], strobeSet(data->wstrb, i+1),
+            data->wdata[i+2], strobeSet(data->wstrb, i+2), data->wdata[i+3], strobeSet(data->wstrb, i+3));
+      }
     }
 
     wdataQ.push_back(data);
-
   }
 
-
   int sendDRAMRequest(
       long long addr,
       long long rawAddr,
@@ -851,54 +786,31 @@ extern "C" {
     DRAMCommand *cmd = new DRAMCommand(cmdAddr, cmdSize, cmdTag, cmdIsWr);
 
     // Create multiple DRAM requests, one per burst
-    DRAMRequest **reqs = new DRAMRequest*[cmdSize];
+    DRAMRequest **reqs = cmd->reqs;
     for (int i = 0; i<cmdSize; i++) {
       reqs[i] = new DRAMRequest(cmdAddr + i*burstSizeBytes, cmdRawAddr + i*burstSizeBytes, cmdSize, cmdTag, cmdIsWr, numCycles);
       reqs[i]->cmd = cmd;
     }
-    cmd->reqs = reqs;
 
     if (debug) {
       EPRINTF("[sendDRAMRequest] Called with ");
       reqs[0]->print();
     }
 
-//    if (!useIdealDRAM) {
-      bool skipIssue = false;
-
-      // For each burst request, create an AddrTag
-      for (int i=0; i<cmdSize; i++) {
-        DRAMRequest *req = reqs[i];
-        struct AddrTag at(req->addr, req->tag);
-
-        addrToReqMap[at] = req;
-        skipIssue = false;
-
-        // TODO: Re-examine gather-scatter flow
-        if (!skipIssue) {
-          if (cmdIsWr) {  // Schedule in sendWdata function, when wdata arrives
-            wrequestQ.push_back(req);
-          } else {
-            req->schedule();  // Schedule request with DRAMSim2 / ideal DRAM
-          }
-
-        } else {
-          if (debug) {
-            EPRINTF("                  Skipping addr = %lx (%lx), tag = %lx\n", req->addr, req->rawAddr, req->tag);
-          }
-        }
+    for (int i=0; i<cmdSize; i++) {
+      DRAMRequest *req = reqs[i];
+      if (cmdIsWr) {  // Issued in serviceWRequest, when wdata arrives
+        wrequestQ.push_back(req);
+      } else {
+        issueDRAMRequest(req);
       }
+    }
 
-    // Push request into appropriate channel queue
-    // Note that for ideal DRAM, since "scheduling" a request amounts to pushing the request
-    // onto the right dramRequstQ, this happens within the schedule() method in DRAMRequest
+    // Push request into the response queue of its stream. Bursts of a command stay
+    // contiguous and in order there, whichever channel services them.
     if (dramReady == 1) {
       for (int i=0; i<cmdSize; i++) {
-        if (!useIdealDRAM) {
-          dramRequestQ[cmdTag.streamId].push_back(reqs[i]);
-        }// else {
-//          dramRequestQ[reqs[i]->channelID].push_back(reqs[i]);
-//        }
+        pushDRAMRequestQ(cmdTag.streamId, reqs[i]);
       }
     }
 
@@ -927,12 +839,21 @@ void initDRAM() {
     debug = false;
   }
 
+  EPRINTF("[DRAM] Burst size: %u bytes (%u words of %u bytes)\n", burstSizeBytes, burstSizeWords, wordSizeBytes);
+
   char *numOutstandingBursts = getenv("DRAM_NUM_OUTSTANDING_BURSTS");
   if (numOutstandingBursts != NULL) {
-    if (numOutstandingBursts[0] != 0 && atoi(numOutstandingBursts) > 0) {
-      //sparseCacheSize = atoi(numOutstandingBursts);
+    if (numOutstandingBursts[0] != 0 && atoi(numOutstandingBursts) >= -1) {
+      coalescingCache.setCapacity(atoi(numOutstandingBursts));
     }
   }
+  if (coalescingCache.capacity() == 0) {
+    EPRINTF("[DRAM] Request coalescing disabled\n");
+  } else if (coalescingCache.capacity() < 0) {
+    EPRINTF("[DRAM] Coalescing cache size = unbounded\n");
+  } else {
+    EPRINTF("[DRAM] Coalescing cache size = %ld lines\n", coalescingCache.capacity());
+  }
 
   char *loadDelay = getenv("N3XT_LOAD_DELAY");
   if (loadDelay != NULL) {
@@ -953,12 +874,36 @@ void initDRAM() {
     }
   }
 
+  char *respVar = getenv("DRAM_RESPONSES_PER_CYCLE");
+  if (respVar != NULL) {
+    if (respVar[0] != 0 && atoi(respVar) > 0) {
+      respPerCycle = (uint32_t) atoi(respVar);
+    }
+  }
+  if (respPerCycle > NUM_RESP_PORTS) {
+    EPRINTF("[DRAM] DRAM_RESPONSES_PER_CYCLE (%u) capped at the number of response ports (%d)\n", respPerCycle, NUM_RESP_PORTS);
+    respPerCycle = NUM_RESP_PORTS;
+  }
+  EPRINTF("[DRAM] Responses per cycle: %u\n", respPerCycle);
+
+  char *channelBW = getenv("N3XT_CHANNEL_BYTES_PER_CYCLE");
+  if (channelBW != NULL) {
+    if (channelBW[0] != 0 && atoi(channelBW) > 0) {
+      N3XT_CHANNEL_BYTES_PER_CYCLE = (uint32_t) atoi(channelBW);
+    }
+  }
+
   if (useIdealDRAM) {
-    ASSERT(N3XT_NUM_CHANNELS < MAX_NUM_Q, "ERROR: N3XT_NUM_CHANNELS (%u) must be lesser than MAX_NUM_Q (%u)\n", N3XT_NUM_CHANNELS, MAX_NUM_Q);
+    idealChannelFree.assign(N3XT_NUM_CHANNELS, 0);
     EPRINTF(" ****** Ideal DRAM configuration ******\n");
     EPRINTF("Num channels         : %u\n", N3XT_NUM_CHANNELS);
     EPRINTF("Load delay (cycles)  : %u\n", N3XT_LOAD_DELAY);
     EPRINTF("Store delay (cycles) : %u\n", N3XT_STORE_DELAY);
+    if (N3XT_CHANNEL_BYTES_PER_CYCLE > 0) {
+      EPRINTF("Channel bandwidth    : %u bytes/cycle (peak %lu bytes/cycle)\n", N3XT_CHANNEL_BYTES_PER_CYCLE, (uint64_t)N3XT_CHANNEL_BYTES_PER_CYCLE * N3XT_NUM_CHANNELS);
+    } else {
+      EPRINTF("Channel bandwidth    : unlimited\n");
+    }
     EPRINTF(" **************************************\n");
   }
 
@@ -982,19 +927,61 @@ void initDRAM() {
     DRAMCallbackMethods callbackMethods;
     DRAMSim::TransactionCompleteCB *rwCb = new DRAMSim::Callback<DRAMCallbackMethods, void, unsigned, uint64_t, uint64_t, uint64_t>(&callbackMethods, &DRAMCallbackMethods::txComplete);
     mem->RegisterCallbacks(rwCb, rwCb, NULL);
+
+    // Update DRAMSim2's channels on this many threads; results do not depend on it
+    char *threadsVar = getenv("DRAMSIM_THREADS");
+    if (threadsVar != NULL) {
+      if (threadsVar[0] != 0 && atoi(threadsVar) > 1) {
+        unsigned threads = mem->setUpdateThreads(atoi(threadsVar));
+        EPRINTF("[DRAM] DRAMSim2 channels updated on %u thread(s) (DRAMSIM_THREADS=%d)\n", threads, atoi(threadsVar));
+      }
+    }
+
+    // Bursts must tile DRAMSim2 transactions (TRANSACTION_SIZE = JEDEC_DATA_BUS_BITS / 8 * BL)
+    unsigned busBits = 0, burstLength = 0;
+    ASSERT(mem->getIniUint("JEDEC_DATA_BUS_BITS", &busBits) == 0 && mem->getIniUint("BL", &burstLength) == 0, "ERROR: Unable to read JEDEC_DATA_BUS_BITS / BL from DRAMSim2\n");
+    uint32_t transactionSize = busBits / 8 * burstLength;
+    ASSERT((burstSizeBytes % transactionSize == 0) || (transactionSize % burstSizeBytes == 0), "ERROR: The DUT burst (%u bytes) and DRAMSim2 TRANSACTION_SIZE (%u) must divide one another\n", burstSizeBytes, transactionSize);
+    if (burstSizeBytes >= transactionSize) {
+      dramSimTxPerBurst = burstSizeBytes / transactionSize;
+    } else {
+      dramSimTxPerBurst = 1;
+      EPRINTF("[DRAM] WARNING: %u-byte bursts are smaller than DRAMSim2 TRANSACTION_SIZE (%u); each burst occupies a full transaction\n", burstSizeBytes, transactionSize);
+    }
+    EPRINTF("[DRAM] DRAMSim2 transaction size: %u bytes, %u transaction(s) per burst\n", transactionSize, dramSimTxPerBurst);
   }
 
-  // Instantiate 64-to-32-bit address remapper
+  // Device memory, shared with the host if it passed us a file at SIM_DEVMEM_FD,
+  // and the 64-to-32-bit address remapper over it
+  deviceMemory = initDeviceArena(SIM_DEVMEM_FD);
   remapper = new AddrRemapper();
 
-  // Open trace file
-  char *traceFileName = NULL;
-  if (useIdealDRAM) {
-    traceFileName = "trace_n3xt.log";
+  // Allocators for burst payloads and per-command request arrays
+  burstPool = new SlabAllocator("burst", burstSizeBytes);
+  reqArrayPool = new SizeClassAllocator("DRAMRequest*[]");
+
+  // Open binary trace file
+  char *traceVar = getenv("DRAM_TRACE");
+  if (traceVar != NULL && traceVar[0] != 0 && atoi(traceVar) > 0) {
+    char *traceFileName = NULL;
+    if (useIdealDRAM) {
+      traceFileName = "trace_n3xt.bin";
+    } else {
+      traceFileName = "trace_dramsim.bin";
+    }
+    traceWriter = new DRAMTraceWriter(traceFileName, useIdealDRAM ? TRACE_N3XT : TRACE_DRAMSIM, burstSizeBytes);
+    EPRINTF("[DRAM] Writing binary trace to %s\n", traceFileName);
   } else {
-    traceFileName = "trace_dramsim.log";
+    EPRINTF("[DRAM] DRAM trace disabled\n");
+  }
+}
+
+void closeDRAMTrace() {
+  if (traceWriter != NULL) {
+    traceWriter->close();
+    EPRINTF("[DRAM] Wrote %lu trace records\n", traceWriter->numRecords);
+    delete traceWriter;
+    traceWriter = NULL;
   }
-  traceFp = fopen(traceFileName, "w");
-  ASSERT(traceFp != NULL, "Unable to open file %s!\n", traceFileName);
 }
 
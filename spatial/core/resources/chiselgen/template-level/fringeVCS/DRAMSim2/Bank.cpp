@@ -39,62 +39,110 @@
 using namespace std;
 using namespace DRAMSim;
 
+//columns per page of stored data
+static const unsigned PAGE_COLS = 64;
+//marks an empty slot in the page table
+static const unsigned NO_PAGE = (unsigned)-1;
+
 Bank::Bank(ostream &dramsim_log_):
 		currentState(dramsim_log_), 
-		rowEntries(NUM_COLS),
+		pageSlots(16),
+		numPages(0),
 		dramsim_log(dramsim_log_)
-{}
+{
+	for (size_t i=0;i<pageSlots.size();i++)
+	{
+		pageSlots[i].page = NO_PAGE;
+	}
+}
 
 /* The bank class is just a glorified sparse storage data structure
  * that keeps track of written data in case the simulator wants a
  * function DRAM model
  *
- * A vector of size NUM_COLS keeps a linked list of rows and their
- * associated values.
+ * Data is kept a page of PAGE_COLS columns of a row at a time: the first
+ * write to a page adds PAGE_COLS data pointers, all starting out as the
+ * tracer buffer, and an entry for the page in an open-addressed (linear
+ * probing) table that is kept at most half full. Finding a page is O(1)
+ * however many rows have been written, and pages are packed in a single
+ * vector.
  *
- * write() adds an entry to the proper linked list or replaces the
- * 	value in a row that was already written
+ * write() adds a page if there is none yet, then replaces the value in
+ * 	the column
  *
- * read() searches for a node with the right row value, if not found
- * 	returns the tracer value 0xDEADBEEF
+ * read() returns the value in the row and column, which is the tracer
+ * 	value 0xDEADBEEF if it was never written
  * 
  *	TODO: if anyone wants to actually store data, see the 'data_storage' branch and perhaps try to merge that into master
  */
 
+uint64_t Bank::pageKey(const BusPacket *busPacket)
+{
+	return ((uint64_t)busPacket->row << 32) | (busPacket->column / PAGE_COLS);
+}
+
+void *&Bank::pageData(const PageSlot &slot, const BusPacket *busPacket)
+{
+	return pages[(size_t)slot.page * PAGE_COLS + busPacket->column % PAGE_COLS];
+}
 
+//the slot holding the page for 'key', or the empty slot where it would go
+Bank::PageSlot &Bank::findPage(uint64_t key)
+{
+	size_t mask = pageSlots.size() - 1;
+	size_t i = (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+	while (pageSlots[i].page != NO_PAGE && pageSlots[i].key != key)
+	{
+		i = (i + 1) & mask;
+	}
+	return pageSlots[i];
+}
 
-Bank::DataStruct *Bank::searchForRow(unsigned row, DataStruct *head)
+void Bank::growPageSlots()
 {
-	while (head != NULL)
+	vector<PageSlot> oldSlots(pageSlots.size() * 2);
+	oldSlots.swap(pageSlots);
+	for (size_t i=0;i<pageSlots.size();i++)
 	{
-		if (head->row == row)
+		pageSlots[i].page = NO_PAGE;
+	}
+	for (size_t i=0;i<oldSlots.size();i++)
+	{
+		if (oldSlots[i].page != NO_PAGE)
 		{
-			//found it
-			return head;
+			findPage(oldSlots[i].key) = oldSlots[i];
 		}
-		//keep looking
-		head = head->next;
 	}
-	//if we get here, didn't find it
-	return NULL;
+}
+
+//the data read from rows that were never written: a single buffer, shared
+//by all banks and never freed, holding the tracer value
+void *Bank::unwrittenData()
+{
+	static void *const garbage = newUnwrittenData();
+	return garbage;
+}
+
+void *Bank::newUnwrittenData()
+{
+	void *garbage = calloc(BL * (JEDEC_DATA_BUS_BITS/8),1);
+	((long *)garbage)[0] = 0xdeadbeef; // tracer value
+	return garbage;
 }
 
 void Bank::read(BusPacket *busPacket)
 {
-	DataStruct *rowHeadNode = rowEntries[busPacket->column];
-	DataStruct *foundNode = NULL;
+	PageSlot &slot = findPage(pageKey(busPacket));
 
-	if ((foundNode = Bank::searchForRow(busPacket->row, rowHeadNode)) == NULL)
+	if (slot.page == NO_PAGE)
 	{
-		// the row hasn't been written before, so it isn't in the list
+		// the page hasn't been written before, so it isn't in the table
 		//if(SHOW_SIM_OUTPUT) DEBUG("== Warning - Read from previously unwritten row " << busPacket->row);
-		void *garbage = calloc(BL * (JEDEC_DATA_BUS_BITS/8),1);
-		((long *)garbage)[0] = 0xdeadbeef; // tracer value
-		busPacket->data = garbage;
+		busPacket->data = unwrittenData();
 	}
 	else // found it
 	{
-		busPacket->data = foundNode->data;
+		busPacket->data = pageData(slot, busPacket);
 	}
 
 	//the return packet should be a data packet, not a read packet
@@ -113,32 +161,28 @@ void Bank::write(const BusPacket *busPacket)
 		exit(-1);
 	}
 
-	// head of the list we need to search
-	DataStruct *rowHeadNode = rowEntries[busPacket->column];
-	DataStruct *foundNode = NULL;
+	uint64_t key = pageKey(busPacket);
+	PageSlot *slot = &findPage(key);
 
-	if ((foundNode = Bank::searchForRow(busPacket->row, rowHeadNode)) == NULL)
-	{
-		//not found
-		DataStruct *newRowNode = (DataStruct *)malloc(sizeof(DataStruct));
-
-		//insert at the head for speed
-		//TODO: Optimize this data structure for speedier lookups?
-		newRowNode->row = busPacket->row;
-		newRowNode->data = busPacket->data;
-		newRowNode->next = rowHeadNode;
-		rowEntries[busPacket->column] = newRowNode;
-	}
-	else
+	if (slot->page == NO_PAGE)
 	{
-		// found it, just plaster in the new data
-		foundNode->data = busPacket->data;
-		if (DEBUG_BANKS)
+		//not found, add a page (keeping the table at most half full)
+		if ((numPages + 1) * 2 > pageSlots.size())
 		{
-			PRINTN(" -- Bank "<<busPacket->bank<<" writing to physical address 0x" << hex << busPacket->physicalAddress<<dec<<":");
-			busPacket->printData();
-			PRINT("");
+			growPageSlots();
+			slot = &findPage(key);
 		}
+		slot->key = key;
+		slot->page = numPages++;
+		pages.resize((size_t)numPages * PAGE_COLS, unwrittenData());
+	}
+	else if (DEBUG_BANKS && pageData(*slot, busPacket) != unwrittenData())
+	{
+		PRINTN(" -- Bank "<<busPacket->bank<<" writing to physical address 0x" << hex << busPacket->physicalAddress<<dec<<":");
+		busPacket->printData();
+		PRINT("");
 	}
-}
 
+	// just plaster in the new data
+	pageData(*slot, busPacket) = busPacket->data;
+}
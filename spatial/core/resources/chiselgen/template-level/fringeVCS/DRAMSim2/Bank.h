@@ -48,17 +48,19 @@
 #include "BankState.h"
 #include "BusPacket.h"
 #include <iostream>
+#include <vector>
 
 namespace DRAMSim
 {
 class Bank
 {
-	typedef struct _DataStruct
+	//slot of the open-addressed page table: which page of which row it is
+	//	for, and where that page's data is in 'pages'
+	typedef struct _PageSlot
 	{
-		unsigned row;
-		void *data;
-		struct _DataStruct *next;
-	} DataStruct;
+		uint64_t key;
+		unsigned page;
+	} PageSlot;
 
 public:
 	//functions
@@ -71,10 +73,17 @@ public:
 
 private:
 	// private member
-	std::vector<DataStruct *> rowEntries;
+	std::vector<PageSlot> pageSlots;
+	std::vector<void *> pages;
+	unsigned numPages;
 	ostream &dramsim_log; 
 
-	static DataStruct *searchForRow(unsigned row, DataStruct *head);
+	static uint64_t pageKey(const BusPacket *busPacket);
+	void *&pageData(const PageSlot &slot, const BusPacket *busPacket);
+	PageSlot &findPage(uint64_t key);
+	void growPageSlots();
+	static void *unwrittenData();
+	static void *newUnwrittenData();
 };
 }
 
@@ -56,7 +56,14 @@ BusPacket::BusPacket(BusPacketType packtype, uint64_t physicalAddr, uint64_t tag
 	rank(r),
 	physicalAddress(physicalAddr),
 	tag(tag),
-	data(dat)
+	data(dat),
+	prev(NULL),
+	next(NULL),
+	bankPrev(NULL),
+	bankNext(NULL),
+	rowPrev(NULL),
+	rowNext(NULL),
+	queueOrder(0)
 {}
 
 void BusPacket::print(uint64_t currentClockCycle, bool dataStart)
@@ -66,6 +66,15 @@ public:
 	uint64_t tag;
 	void *data;
 
+	//links and position in the command queue, only valid while queued
+	BusPacket *prev;
+	BusPacket *next;
+	BusPacket *bankPrev;
+	BusPacket *bankNext;
+	BusPacket *rowPrev;
+	BusPacket *rowNext;
+	uint64_t queueOrder;
+
 	//Functions
 	BusPacket(BusPacketType packtype, uint64_t physicalAddr, uint64_t tag, unsigned col, unsigned rw, unsigned r, unsigned b, void *dat, ostream &dramsim_log_);
 
@@ -89,6 +89,62 @@ namespace ClockDomain
 
 
 
+	// Number of callbacks the next 'updates' calls to update() would make
+	uint64_t ClockDomainCrosser::callbacksIn(uint64_t updates) const
+	{
+		if (clock1 == clock2)
+		{
+			return updates;
+		}
+		// the counters go back to 0 every clock2/gcd updates, which make
+		// clock1/gcd callbacks; only the rest has to be worked out
+		uint64_t g = gcd(clock1, clock2);
+		uint64_t counter = counter1 + (updates % (clock2/g)) * clock1;
+		return (updates / (clock2/g)) * (clock1/g) + (counter + clock2 - 1) / clock2 - counter2 / clock2;
+	}
+
+	// Most calls to update() that make no more than 'callbacks' callbacks
+	uint64_t ClockDomainCrosser::updatesFor(uint64_t callbacks) const
+	{
+		if (clock1 == clock2)
+		{
+			return callbacks;
+		}
+		uint64_t g = gcd(clock1, clock2);
+		uint64_t periods = callbacks / (clock1/g);
+		uint64_t counter = counter2 + (callbacks % (clock1/g)) * clock2;
+		return periods * (clock2/g) + (counter - counter1) / clock1;
+	}
+
+	// Same as 'updates' calls to update() with the callbacks left out; returns
+	// the number of callbacks that were left out
+	uint64_t ClockDomainCrosser::skip(uint64_t updates)
+	{
+		uint64_t callbacks = callbacksIn(updates);
+		if (clock1 == clock2)
+		{
+			return callbacks;
+		}
+		// where update() would have left the counters: counter1 counts the
+		// updates since they were last reset, counter2 has caught up with it
+		uint64_t period = clock2/gcd(clock1, clock2);
+		counter1 = ((counter1 / clock1 + updates % period) % period) * clock1;
+		counter2 = (counter1 + clock2 - 1) / clock2 * clock2;
+		return callbacks;
+	}
+
+	uint64_t ClockDomainCrosser::gcd(uint64_t a, uint64_t b)
+	{
+		while (b != 0)
+		{
+			uint64_t t = a % b;
+			a = b;
+			b = t;
+		}
+		return a;
+	}
+
+
 	void TestObj::cb()
 	{
 			cout << "In Callback\n";
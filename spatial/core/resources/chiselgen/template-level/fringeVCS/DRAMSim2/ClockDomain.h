@@ -48,6 +48,12 @@ namespace ClockDomain
 		ClockDomainCrosser(uint64_t _clock1, uint64_t _clock2, ClockUpdateCB *_callback);
 		ClockDomainCrosser(double ratio, ClockUpdateCB *_callback);
 		void update();
+		uint64_t callbacksIn(uint64_t updates) const;
+		uint64_t updatesFor(uint64_t callbacks) const;
+		uint64_t skip(uint64_t updates);
+
+		private:
+		static uint64_t gcd(uint64_t a, uint64_t b);
 	};
 
 
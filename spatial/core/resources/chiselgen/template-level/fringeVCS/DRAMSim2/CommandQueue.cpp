@@ -35,6 +35,7 @@
 
 
 
+
 //CommandQueue.cpp
 //
 //Class file for command queue object
@@ -43,12 +44,92 @@
 #include "CommandQueue.h"
 #include "MemoryController.h"
 #include <assert.h>
+#include <algorithm>
 
 using namespace DRAMSim;
 
-CommandQueue::CommandQueue(vector< vector<BankState> > &states, ostream &dramsim_log_) :
+BusPacketQueue::BusPacketQueue() :
+		banks(NUM_BANKS),
+		rows(NUM_BANKS),
+		count(0),
+		nextOrder(0)
+{
+}
+
+void BusPacketQueue::append(PacketList &list, BusPacket *busPacket, Link prev, Link next)
+{
+	busPacket->*prev = list.tail;
+	busPacket->*next = NULL;
+	if (list.tail == NULL)
+	{
+		list.head = busPacket;
+	}
+	else
+	{
+		list.tail->*next = busPacket;
+	}
+	list.tail = busPacket;
+}
+
+void BusPacketQueue::unlink(PacketList &list, BusPacket *busPacket, Link prev, Link next)
+{
+	if (busPacket->*prev == NULL)
+	{
+		list.head = busPacket->*next;
+	}
+	else
+	{
+		(busPacket->*prev)->*next = busPacket->*next;
+	}
+	if (busPacket->*next == NULL)
+	{
+		list.tail = busPacket->*prev;
+	}
+	else
+	{
+		(busPacket->*next)->*prev = busPacket->*prev;
+	}
+	busPacket->*prev = NULL;
+	busPacket->*next = NULL;
+}
+
+//Adds a packet to the back of the queue, and of its bank's and row's lists
+void BusPacketQueue::push_back(BusPacket *busPacket)
+{
+	busPacket->queueOrder = nextOrder++;
+	append(packets, busPacket, &BusPacket::prev, &BusPacket::next);
+	append(banks[busPacket->bank], busPacket, &BusPacket::bankPrev, &BusPacket::bankNext);
+	append(rows[busPacket->bank][busPacket->row], busPacket, &BusPacket::rowPrev, &BusPacket::rowNext);
+	count++;
+}
+
+//Unlinks a queued packet (which is not deleted)
+void BusPacketQueue::remove(BusPacket *busPacket)
+{
+	unlink(packets, busPacket, &BusPacket::prev, &BusPacket::next);
+	unlink(banks[busPacket->bank], busPacket, &BusPacket::bankPrev, &BusPacket::bankNext);
+
+	unordered_map<unsigned, PacketList> &bankRows = rows[busPacket->bank];
+	unordered_map<unsigned, PacketList>::iterator it = bankRows.find(busPacket->row);
+	unlink(it->second, busPacket, &BusPacket::rowPrev, &BusPacket::rowNext);
+	if (it->second.head == NULL)
+	{
+		bankRows.erase(it);
+	}
+	count--;
+}
+
+//First queued packet going to a bank and row, or NULL
+BusPacket *BusPacketQueue::rowFront(unsigned bank, unsigned row) const
+{
+	unordered_map<unsigned, PacketList>::const_iterator it = rows[bank].find(row);
+	return it == rows[bank].end() ? NULL : it->second.head;
+}
+
+CommandQueue::CommandQueue(vector< vector<BankState> > &states, RecyclingPool<BusPacket> &busPacketPool_, ostream &dramsim_log_) :
 		dramsim_log(dramsim_log_),
 		bankStates(states),
+		busPacketPool(busPacketPool_),
 		nextBank(0),
 		nextRank(0),
 		nextBankPRE(0),
@@ -80,50 +161,33 @@ CommandQueue::CommandQueue(vector< vector<BankState> > &states, ostream &dramsim
 	rowAccessCounters = vector< vector<unsigned> >(NUM_RANKS, vector<unsigned>(NUM_BANKS,0));
 
 	//create queue based on the structure we want
-	BusPacket1D actualQueue;
-	BusPacket2D perBankQueue = BusPacket2D();
-	queues = BusPacket3D();
-	for (size_t rank=0; rank<NUM_RANKS; rank++)
-	{
-		//this loop will run only once for per-rank and NUM_BANKS times for per-rank-per-bank
-		for (size_t bank=0; bank<numBankQueues; bank++)
-		{
-			actualQueue	= BusPacket1D();
-			perBankQueue.push_back(actualQueue);
-		}
-		queues.push_back(perBankQueue);
-	}
+	//	this will have one queue per rank for per-rank and NUM_BANKS per rank for per-rank-per-bank
+	queues = BusPacket3D(NUM_RANKS, BusPacket2D(numBankQueues));
 
+	//bitmask of the queues that have packets, so that the round robin search
+	//	can skip over the empty ones
+	numQueues = NUM_RANKS * numBankQueues;
+	nonEmptyQueues = vector<uint64_t>((numQueues + 63) / 64, 0);
 
 	//FOUR-bank activation window
-	//	this will count the number of activations within a given window
-	//	(decrementing counter)
+	//	this keeps the cycle of each activation within the last tFAW cycles
 	//
-	//countdown vector will have decrementing counters starting at tFAW
-	//  when the 0th element reaches 0, remove it
-	tFAWCountdown.reserve(NUM_RANKS);
-	for (size_t i=0;i<NUM_RANKS;i++)
-	{
-		//init the empty vectors here so we don't seg fault later
-		tFAWCountdown.push_back(vector<unsigned>());
-	}
+	//when the oldest one is tFAW cycles old, remove it
+	tFAWActivates = vector< deque<uint64_t> >(NUM_RANKS);
 }
 CommandQueue::~CommandQueue()
 {
 	//ERROR("COMMAND QUEUE destructor");
-	size_t bankMax = NUM_RANKS;
-	if (queuingStructure == PerRank) {
-		bankMax = 1; 
-	}
-	for (size_t r=0; r< NUM_RANKS; r++)
+	for (size_t r=0; r<queues.size(); r++)
 	{
-		for (size_t b=0; b<bankMax; b++) 
+		for (size_t b=0; b<queues[r].size(); b++)
 		{
-			for (size_t i=0; i<queues[r][b].size(); i++)
+			while (!queues[r][b].empty())
 			{
-				delete(queues[r][b][i]);
+				BusPacket *packet = queues[r][b].front();
+				queues[r][b].remove(packet);
+				busPacketPool.recycle(packet);
 			}
-			queues[r][b].clear();
 		}
 	}
 }
@@ -157,6 +221,20 @@ void CommandQueue::enqueue(BusPacket *newBusPacket)
 		ERROR("== Error - Unknown queuing structure");
 		exit(0);
 	}
+
+	unsigned index = queueIndex(rank, bank);
+	nonEmptyQueues[index / 64] |= (uint64_t)1 << (index % 64);
+}
+
+//Removes a packet from its queue, keeping the non-empty bitmask up to date
+void CommandQueue::removePacket(BusPacketQueue &queue, BusPacket *busPacket)
+{
+	queue.remove(busPacket);
+	if (queue.empty())
+	{
+		unsigned index = queueIndex(busPacket->rank, busPacket->bank);
+		nonEmptyQueues[index / 64] &= ~((uint64_t)1 << (index % 64));
+	}
 }
 
 //Removes the next item from the command queue based on the system's
@@ -167,25 +245,19 @@ bool CommandQueue::pop(BusPacket **busPacket)
 	//	figures out the sliding window requirement for tFAW
 	//
 	//deal with tFAW book-keeping
-	//	each rank has it's own counter since the restriction is on a device level
+	//	each rank has it's own window since the restriction is on a device level
 	for (size_t i=0;i<NUM_RANKS;i++)
 	{
-		//decrement all the counters we have going
-		for (size_t j=0;j<tFAWCountdown[i].size();j++)
+		//the head will always be the oldest activation, so check if it has left the window
+		if (tFAWActivates[i].size()>0 && currentClockCycle - tFAWActivates[i].front() >= tFAW)
 		{
-			tFAWCountdown[i][j]--;
-		}
-
-		//the head will always be the smallest counter, so check if it has reached 0
-		if (tFAWCountdown[i].size()>0 && tFAWCountdown[i][0]==0)
-		{
-			tFAWCountdown[i].erase(tFAWCountdown[i].begin());
+			tFAWActivates[i].pop_front();
 		}
 	}
 
 	/* Now we need to find a packet to issue. When the code picks a packet, it will set
 		 *busPacket = [some eligible packet]
-		 
+
 		 First the code looks if any refreshes need to go
 		 Then it looks for data packets
 		 Otherwise, it starts looking for rows to close (in open page)
@@ -201,27 +273,19 @@ bool CommandQueue::pop(BusPacket **busPacket)
 			//look for an open bank
 			for (size_t b=0;b<NUM_BANKS;b++)
 			{
-				vector<BusPacket *> &queue = getCommandQueue(refreshRank,b);
+				BusPacketQueue &queue = getCommandQueue(refreshRank,b);
 				//checks to make sure that all banks are idle
 				if (bankStates[refreshRank][b].currentBankState == RowActive)
 				{
 					foundActiveOrTooEarly = true;
 					//if the bank is open, make sure there is nothing else
 					// going there before we close it
-					for (size_t j=0;j<queue.size();j++)
+					BusPacket *packet = queue.rowFront(b, bankStates[refreshRank][b].openRowAddress);
+					if (packet != NULL && packet->busPacketType != ACTIVATE && isIssuable(packet))
 					{
-						BusPacket *packet = queue[j];
-						if (packet->row == bankStates[refreshRank][b].openRowAddress &&
-								packet->bank == b)
-						{
-							if (packet->busPacketType != ACTIVATE && isIssuable(packet))
-							{
-								*busPacket = packet;
-								queue.erase(queue.begin() + j);
-								sendingREF = true;
-							}
-							break;
-						}
+						*busPacket = packet;
+						removePacket(queue, packet);
+						sendingREF = true;
 					}
 
 					break;
@@ -241,7 +305,7 @@ bool CommandQueue::pop(BusPacket **busPacket)
 			//	reset flags and rank pointer
 			if (!foundActiveOrTooEarly && bankStates[refreshRank][0].currentBankState != PowerDown)
 			{
-				*busPacket = new BusPacket(REFRESH, 0, 0, 0, 0, refreshRank, 0, 0, dramsim_log);
+				*busPacket = busPacketPool.create(REFRESH, 0, 0, 0, 0, refreshRank, 0, nullptr, dramsim_log);
 				refreshRank = -1;
 				refreshWaiting = false;
 				sendingREF = true;
@@ -254,75 +318,56 @@ bool CommandQueue::pop(BusPacket **busPacket)
 			bool foundIssuable = false;
 			unsigned startingRank = nextRank;
 			unsigned startingBank = nextBank;
-			do
+			unsigned startingQueue = queueIndex(nextRank, nextBank);
+			//round robin over the queues that have something in them
+			for (unsigned offset = nextNonEmptyQueue(startingQueue, 0); offset < numQueues;
+					offset = nextNonEmptyQueue(startingQueue, offset + 1))
 			{
-				vector<BusPacket *> &queue = getCommandQueue(nextRank, nextBank);
-				//make sure there is something in this queue first
-				//	also make sure a rank isn't waiting for a refresh
+				queueAt((startingQueue + offset) % numQueues, nextRank, nextBank);
+				BusPacketQueue &queue = getCommandQueue(nextRank, nextBank);
+				//make sure a rank isn't waiting for a refresh
 				//	if a rank is waiting for a refesh, don't issue anything to it until the
 				//		refresh logic above has sent one out (ie, letting banks close)
-				if (!queue.empty() && !((nextRank == refreshRank) && refreshWaiting))
+				if (!((nextRank == refreshRank) && refreshWaiting))
 				{
 					if (queuingStructure == PerRank)
 					{
-
-						//search from beginning to find first issuable bus packet
-						for (size_t i=0;i<queue.size();i++)
+						//find the first issuable bus packet
+						BusPacket *packet = firstIssuable(queue, nextRank);
+						if (packet != NULL)
 						{
-							if (isIssuable(queue[i]))
-							{
-								//check to make sure we aren't removing a read/write that is paired with an activate
-								if (i>0 && queue[i-1]->busPacketType==ACTIVATE &&
-										queue[i-1]->physicalAddress == queue[i]->physicalAddress)
-									continue;
-
-								*busPacket = queue[i];
-								queue.erase(queue.begin()+i);
-								foundIssuable = true;
-								break;
-							}
+							*busPacket = packet;
+							removePacket(queue, packet);
+							foundIssuable = true;
 						}
 					}
 					else
 					{
-						if (isIssuable(queue[0]))
+						if (isIssuable(queue.front()))
 						{
 
 							//no need to search because if the front can't be sent,
 							// then no chance something behind it can go instead
-							*busPacket = queue[0];
-							queue.erase(queue.begin());
+							*busPacket = queue.front();
+							removePacket(queue, *busPacket);
 							foundIssuable = true;
 						}
 					}
 
 				}
 
-				//if we found something, break out of do-while
+				//if we found something, break out of the round robin
 				if (foundIssuable) break;
-
-				//rank round robin
-				if (queuingStructure == PerRank)
-				{
-					nextRank = (nextRank + 1) % NUM_RANKS;
-					if (startingRank == nextRank)
-					{
-						break;
-					}
-				}
-				else 
-				{
-					nextRankAndBank(nextRank, nextBank);
-					if (startingRank == nextRank && startingBank == nextBank)
-					{
-						break;
-					}
-				}
 			}
-			while (true);
 
 			//if we couldn't find anything to send, return false
-			if (!foundIssuable) return false;
+			//	(having gone all the way around)
+			if (!foundIssuable)
+			{
+				nextRank = startingRank;
+				nextBank = startingBank;
+				return false;
+			}
 		}
 	}
 	else if (rowBufferPolicy==OpenPage)
@@ -340,34 +385,22 @@ bool CommandQueue::pop(BusPacket **busPacket)
 					sendREF = false;
 					bool closeRow = true;
 					//search for commands going to an open row
-					vector <BusPacket *> &refreshQueue = getCommandQueue(refreshRank,b);
+					BusPacketQueue &refreshQueue = getCommandQueue(refreshRank,b);
 
-					for (size_t j=0;j<refreshQueue.size();j++)
+					//the first command in the queue going to the same row . . .
+					BusPacket *packet = refreshQueue.rowFront(b, bankStates[refreshRank][b].openRowAddress);
+					// . . . if it is not an activate . . .
+					//	(if it is, no other command will be of interest)
+					if (packet != NULL && packet->busPacketType != ACTIVATE)
 					{
-						BusPacket *packet = refreshQueue[j];
-						//if a command in the queue is going to the same row . . .
-						if (bankStates[refreshRank][b].openRowAddress == packet->row &&
-								b == packet->bank)
+						closeRow = false;
+						// . . . and can be issued . . .
+						if (isIssuable(packet))
 						{
-							// . . . and is not an activate . . .
-							if (packet->busPacketType != ACTIVATE)
-							{
-								closeRow = false;
-								// . . . and can be issued . . .
-								if (isIssuable(packet))
-								{
-									//send it out
-									*busPacket = packet;
-									refreshQueue.erase(refreshQueue.begin()+j);
-									sendingREForPRE = true;
-								}
-								break;
-							}
-							else //command is an activate
-							{
-								//if we've encountered another act, no other command will be of interest
-								break;
-							}
+							//send it out
+							*busPacket = packet;
+							removePacket(refreshQueue, packet);
+							sendingREForPRE = true;
 						}
 					}
 
@@ -375,7 +408,7 @@ bool CommandQueue::pop(BusPacket **busPacket)
 					if (closeRow && currentClockCycle >= bankStates[refreshRank][b].nextPrecharge)
 					{
 						rowAccessCounters[refreshRank][b]=0;
-						*busPacket = new BusPacket(PRECHARGE, 0, 0, 0, 0, refreshRank, b, 0, dramsim_log);
+						*busPacket = busPacketPool.create(PRECHARGE, 0, 0, 0, 0, refreshRank, b, nullptr, dramsim_log);
 						sendingREForPRE = true;
 					}
 					break;
@@ -394,7 +427,7 @@ bool CommandQueue::pop(BusPacket **busPacket)
 			//	reset flags and rank pointer
 			if (sendREF && bankStates[refreshRank][0].currentBankState != PowerDown)
 			{
-				*busPacket = new BusPacket(REFRESH, 0, 0, 0, 0, refreshRank, 0, 0, dramsim_log);
+				*busPacket = busPacketPool.create(REFRESH, 0, 0, 0, 0, refreshRank, 0, nullptr, dramsim_log);
 				refreshRank = -1;
 				refreshWaiting = false;
 				sendingREForPRE = true;
@@ -405,87 +438,50 @@ bool CommandQueue::pop(BusPacket **busPacket)
 		{
 			unsigned startingRank = nextRank;
 			unsigned startingBank = nextBank;
+			unsigned startingQueue = queueIndex(nextRank, nextBank);
 			bool foundIssuable = false;
-			do // round robin over queues
+			// round robin over the queues that have something in them
+			for (unsigned offset = nextNonEmptyQueue(startingQueue, 0); offset < numQueues;
+					offset = nextNonEmptyQueue(startingQueue, offset + 1))
 			{
-				vector<BusPacket *> &queue = getCommandQueue(nextRank,nextBank);
-				//make sure there is something there first
-				if (!queue.empty() && !((nextRank == refreshRank) && refreshWaiting))
+				queueAt((startingQueue + offset) % numQueues, nextRank, nextBank);
+				BusPacketQueue &queue = getCommandQueue(nextRank,nextBank);
+				if (!((nextRank == refreshRank) && refreshWaiting))
 				{
-					//search from the beginning to find first issuable bus packet
-					for (size_t i=0;i<queue.size();i++)
+					//find the first issuable bus packet that doesn't depend on one ahead of it
+					BusPacket *packet = firstIssuable(queue, nextRank);
+					if (packet != NULL)
 					{
-						BusPacket *packet = queue[i];
-						if (isIssuable(packet))
-						{
-							//check for dependencies
-							bool dependencyFound = false;
-							for (size_t j=0;j<i;j++)
-							{
-								BusPacket *prevPacket = queue[j];
-								if (prevPacket->busPacketType != ACTIVATE &&
-										prevPacket->bank == packet->bank &&
-										prevPacket->row == packet->row)
-								{
-									dependencyFound = true;
-									break;
-								}
-							}
-							if (dependencyFound) continue;
-
-							*busPacket = packet;
-
-							//if the bus packet before is an activate, that is the act that was
-							//	paired with the column access we are removing, so we have to remove
-							//	that activate as well (check i>0 because if i==0 then theres nothing before it)
-							if (i>0 && queue[i-1]->busPacketType == ACTIVATE)
-							{
-								rowAccessCounters[(*busPacket)->rank][(*busPacket)->bank]++;
-								// i is being returned, but i-1 is being thrown away, so must delete it here 
-								delete (queue[i-1]);
-
-								// remove both i-1 (the activate) and i (we've saved the pointer in *busPacket)
-								queue.erase(queue.begin()+i-1,queue.begin()+i+1);
-							}
-							else // there's no activate before this packet
-							{
-								//or just remove the one bus packet
-								queue.erase(queue.begin()+i);
-							}
+						*busPacket = packet;
 
-							foundIssuable = true;
-							break;
+						//if the bus packet before is an activate, that is the act that was
+						//	paired with the column access we are removing, so we have to remove
+						//	that activate as well
+						BusPacket *prevPacket = packet->prev;
+						if (prevPacket != NULL && prevPacket->busPacketType == ACTIVATE)
+						{
+							rowAccessCounters[(*busPacket)->rank][(*busPacket)->bank]++;
+							// packet is being returned, but prevPacket is being thrown away, so must recycle it here
+							removePacket(queue, prevPacket);
+							busPacketPool.recycle(prevPacket);
 						}
+						removePacket(queue, packet);
+
+						foundIssuable = true;
 					}
 				}
 
-				//if we found something, break out of do-while
+				//if we found something, break out of the round robin
 				if (foundIssuable) break;
-
-				//rank round robin
-				if (queuingStructure == PerRank)
-				{
-					nextRank = (nextRank + 1) % NUM_RANKS;
-					if (startingRank == nextRank)
-					{
-						break;
-					}
-				}
-				else 
-				{
-					nextRankAndBank(nextRank, nextBank); 
-					if (startingRank == nextRank && startingBank == nextBank)
-					{
-						break;
-					}
-				}
 			}
-			while (true);
 
 			//if nothing was issuable, see if we can issue a PRE to an open bank
 			//	that has no other commands waiting
 			if (!foundIssuable)
 			{
+				nextRank = startingRank;
+				nextBank = startingBank;
+
 				//search for banks to close
 				bool sendingPRE = false;
 				unsigned startingRank = nextRankPRE;
@@ -493,21 +489,12 @@ bool CommandQueue::pop(BusPacket **busPacket)
 
 				do // round robin over all ranks and banks
 				{
-					vector <BusPacket *> &queue = getCommandQueue(nextRankPRE, nextBankPRE);
-					bool found = false;
+					BusPacketQueue &queue = getCommandQueue(nextRankPRE, nextBankPRE);
 					//check if bank is open
 					if (bankStates[nextRankPRE][nextBankPRE].currentBankState == RowActive)
 					{
-						for (size_t i=0;i<queue.size();i++)
-						{
-							//if there is something going to that bank and row, then we don't want to send a PRE
-							if (queue[i]->bank == nextBankPRE &&
-									queue[i]->row == bankStates[nextRankPRE][nextBankPRE].openRowAddress)
-							{
-								found = true;
-								break;
-							}
-						}
+						//if there is something going to that bank and row, then we don't want to send a PRE
+						bool found = queue.rowFront(nextBankPRE, bankStates[nextRankPRE][nextBankPRE].openRowAddress) != NULL;
 
 						//if nothing found going to that bank and row or too many accesses have happend, close it
 						if (!found || rowAccessCounters[nextRankPRE][nextBankPRE]==TOTAL_ROW_ACCESSES)
@@ -516,7 +503,7 @@ bool CommandQueue::pop(BusPacket **busPacket)
 							{
 								sendingPRE = true;
 								rowAccessCounters[nextRankPRE][nextBankPRE] = 0;
-								*busPacket = new BusPacket(PRECHARGE, 0, 0, 0, 0, nextRankPRE, nextBankPRE, 0, dramsim_log);
+								*busPacket = busPacketPool.create(PRECHARGE, 0, 0, 0, 0, nextRankPRE, nextBankPRE, nullptr, dramsim_log);
 								break;
 							}
 						}
@@ -545,19 +532,103 @@ bool CommandQueue::pop(BusPacket **busPacket)
 		nextRankAndBank(nextRank, nextBank);
 	}
 
-	//if its an activate, add a tfaw counter
+	//if its an activate, add it to the tfaw window
 	if ((*busPacket)->busPacketType==ACTIVATE)
 	{
-		tFAWCountdown[(*busPacket)->rank].push_back(tFAW);
+		tFAWActivates[(*busPacket)->rank].push_back(currentClockCycle);
 	}
 
 	return true;
 }
 
+//checks whether any command at all could be issued to a bank this cycle,
+//	without looking at the commands
+bool CommandQueue::bankMayIssue(unsigned rank, unsigned bank)
+{
+	BankState &state = bankStates[rank][bank];
+	switch (state.currentBankState)
+	{
+	case Idle:
+	case Refreshing:
+		//only activates
+		return currentClockCycle >= state.nextActivate && tFAWActivates[rank].size() < 4;
+	case RowActive:
+		//only column accesses to the open row
+		return (currentClockCycle >= state.nextRead || currentClockCycle >= state.nextWrite) &&
+		       rowAccessCounters[rank][bank] < TOTAL_ROW_ACCESSES;
+	default:
+		return false;
+	}
+}
+
+//checks whether busPacket is a read/write that is paired with an activate
+//	still in the queue ahead of it
+bool CommandQueue::waitingForActivate(BusPacket *busPacket)
+{
+	return busPacket->prev != NULL && busPacket->prev->busPacketType == ACTIVATE &&
+	       busPacket->prev->physicalAddress == busPacket->physicalAddress;
+}
+
+//finds the packet the original front-to-back search of the queue would issue:
+//	the first one that is issuable and, in open page, has no column access to
+//	the same bank and row ahead of it, or, in close page, is not waiting for
+//	its activate. Both only depend on the packet's own bank, so each bank is
+//	searched on its own and the earliest candidate wins
+BusPacket *CommandQueue::firstIssuable(BusPacketQueue &queue, unsigned rank)
+{
+	BusPacket *first = NULL;
+	for (size_t b=0;b<NUM_BANKS;b++)
+	{
+		if (queue.bankFront(b) == NULL || !bankMayIssue(rank, b)) continue;
+
+		BusPacket *candidate = NULL;
+		if (bankStates[rank][b].currentBankState == RowActive)
+		{
+			//only column accesses to the open row can be issued, and in open page
+			//	only the first of them has nothing ahead of it
+			for (BusPacket *packet = queue.rowFront(b, bankStates[rank][b].openRowAddress); packet != NULL; packet = packet->rowNext)
+			{
+				if (packet->busPacketType == ACTIVATE) continue;
+				if (isIssuable(packet) && (rowBufferPolicy == OpenPage || !waitingForActivate(packet)))
+				{
+					candidate = packet;
+					break;
+				}
+				if (rowBufferPolicy == OpenPage) break;
+			}
+		}
+		else
+		{
+			//only activates can be issued
+			rowsSeen.clear();
+			for (BusPacket *packet = queue.bankFront(b); packet != NULL; packet = packet->bankNext)
+			{
+				if (isIssuable(packet) &&
+				    (rowBufferPolicy == OpenPage ? find(rowsSeen.begin(), rowsSeen.end(), packet->row) == rowsSeen.end()
+				                                 : !waitingForActivate(packet)))
+				{
+					candidate = packet;
+					break;
+				}
+				if (packet->busPacketType != ACTIVATE)
+				{
+					rowsSeen.push_back(packet->row);
+				}
+			}
+		}
+
+		if (candidate != NULL && (first == NULL || candidate->queueOrder < first->queueOrder))
+		{
+			first = candidate;
+		}
+	}
+	return first;
+}
+
 //check if a rank/bank queue has room for a certain number of bus packets
 bool CommandQueue::hasRoomFor(unsigned numberToEnqueue, unsigned rank, unsigned bank)
 {
-	vector<BusPacket *> &queue = getCommandQueue(rank, bank); 
+	BusPacketQueue &queue = getCommandQueue(rank, bank);
 	return (CMD_QUEUE_DEPTH - queue.size() >= numberToEnqueue);
 }
 
@@ -570,10 +641,11 @@ void CommandQueue::print()
 		for (size_t i=0;i<NUM_RANKS;i++)
 		{
 			PRINT(" = Rank " << i << "  size : " << queues[i][0].size() );
-			for (size_t j=0;j<queues[i][0].size();j++)
+			size_t j = 0;
+			for (BusPacket *packet = queues[i][0].front(); packet != NULL; packet = packet->next, j++)
 			{
 				PRINTN("    "<< j << "]");
-				queues[i][0][j]->print();
+				packet->print();
 			}
 		}
 	}
@@ -588,22 +660,23 @@ void CommandQueue::print()
 			{
 				PRINT("    Bank "<< j << "   size : " << queues[i][j].size() );
 
-				for (size_t k=0;k<queues[i][j].size();k++)
+				size_t k = 0;
+				for (BusPacket *packet = queues[i][j].front(); packet != NULL; packet = packet->next, k++)
 				{
 					PRINTN("       " << k << "]");
-					queues[i][j][k]->print();
+					packet->print();
 				}
 			}
 		}
 	}
 }
 
-/** 
+/**
  * return a reference to the queue for a given rank, bank. Since we
  * don't always have a per bank queuing structure, sometimes the bank
- * argument is ignored (and the 0th index is returned 
+ * argument is ignored (and the 0th index is returned
  */
-vector<BusPacket *> &CommandQueue::getCommandQueue(unsigned rank, unsigned bank)
+BusPacketQueue &CommandQueue::getCommandQueue(unsigned rank, unsigned bank)
 {
 	if (queuingStructure == PerRankPerBank)
 	{
@@ -616,11 +689,72 @@ vector<BusPacket *> &CommandQueue::getCommandQueue(unsigned rank, unsigned bank)
 	else
 	{
 		ERROR("Unknown queue structure");
-		abort(); 
+		abort();
 	}
 
 }
 
+/**
+ * position of a rank, bank queue in the round robin order: ranks for per
+ * rank queues, otherwise the order nextRankAndBank() goes through them
+ */
+unsigned CommandQueue::queueIndex(unsigned rank, unsigned bank)
+{
+	if (queuingStructure == PerRank)
+	{
+		return rank;
+	}
+	else if (schedulingPolicy == RankThenBankRoundRobin)
+	{
+		return bank * NUM_RANKS + rank;
+	}
+	else
+	{
+		return rank * NUM_BANKS + bank;
+	}
+}
+
+//inverse of queueIndex(); leaves bank alone for per rank queues
+void CommandQueue::queueAt(unsigned index, unsigned &rank, unsigned &bank)
+{
+	if (queuingStructure == PerRank)
+	{
+		rank = index;
+	}
+	else if (schedulingPolicy == RankThenBankRoundRobin)
+	{
+		rank = index % NUM_RANKS;
+		bank = index / NUM_RANKS;
+	}
+	else
+	{
+		rank = index / NUM_BANKS;
+		bank = index % NUM_BANKS;
+	}
+}
+
+/**
+ * smallest round robin distance, starting at offset, from startingQueue to a
+ * queue with packets in it. Returns numQueues when there is none before
+ * getting back around to startingQueue
+ */
+unsigned CommandQueue::nextNonEmptyQueue(unsigned startingQueue, unsigned offset)
+{
+	while (offset < numQueues)
+	{
+		unsigned index = (startingQueue + offset) % numQueues;
+		uint64_t bits = nonEmptyQueues[index / 64] >> (index % 64);
+		if (bits != 0)
+		{
+			//bits past numQueues are never set, so this doesn't wrap around
+			return min(offset + (unsigned)__builtin_ctzll(bits), numQueues);
+		}
+		//on to the next word, or back to index 0
+		offset += min(64 - index % 64, numQueues - index);
+	}
+	return numQueues;
+}
+
 //checks if busPacket is allowed to be issued
 bool CommandQueue::isIssuable(BusPacket *busPacket)
 {
@@ -633,7 +767,7 @@ bool CommandQueue::isIssuable(BusPacket *busPacket)
 		if ((bankStates[busPacket->rank][busPacket->bank].currentBankState == Idle ||
 		        bankStates[busPacket->rank][busPacket->bank].currentBankState == Refreshing) &&
 		        currentClockCycle >= bankStates[busPacket->rank][busPacket->bank].nextActivate &&
-		        tFAWCountdown[busPacket->rank].size() < 4)
+		        tFAWActivates[busPacket->rank].size() < 4)
 		{
 			return true;
 		}
@@ -718,6 +852,34 @@ void CommandQueue::needRefresh(unsigned rank)
 	refreshRank = rank;
 }
 
+//true if there is nothing queued and no refresh waiting, so that pop() has
+//	nothing to do until something is enqueued or a refresh is needed
+bool CommandQueue::isIdle()
+{
+	if (refreshWaiting) return false;
+	for (size_t i=0;i<nonEmptyQueues.size();i++)
+	{
+		if (nonEmptyQueues[i] != 0) return false;
+	}
+	return true;
+}
+
+//same as 'cycles' cycles of pop() and step() while idle: only the tFAW
+//	window moves
+void CommandQueue::skipIdle(uint64_t cycles)
+{
+	if (cycles == 0) return;
+	uint64_t lastCycle = currentClockCycle + cycles - 1;
+	for (size_t i=0;i<NUM_RANKS;i++)
+	{
+		while (tFAWActivates[i].size()>0 && lastCycle - tFAWActivates[i].front() >= tFAW)
+		{
+			tFAWActivates[i].pop_front();
+		}
+	}
+	currentClockCycle += cycles;
+}
+
 void CommandQueue::nextRankAndBank(unsigned &rank, unsigned &bank)
 {
 	if (schedulingPolicy == RankThenBankRoundRobin)
@@ -46,23 +46,61 @@
 #include "Transaction.h"
 #include "SystemConfiguration.h"
 #include "SimulatorObject.h"
+#include "RecyclingPool.h"
+#include <deque>
+#include <unordered_map>
 
 using namespace std;
 
 namespace DRAMSim
 {
+//FIFO of bus packets linked through the packets themselves, so that any
+//packet can be removed in O(1). Each bank's packets, and each bank and row's,
+//are also linked in queue order, so that they can be found without walking
+//the rest of the queue
+class BusPacketQueue
+{
+public:
+	BusPacketQueue();
+
+	void push_back(BusPacket *busPacket);
+	void remove(BusPacket *busPacket);
+	BusPacket *front() const { return packets.head; }
+	BusPacket *bankFront(unsigned bank) const { return banks[bank].head; }
+	BusPacket *rowFront(unsigned bank, unsigned row) const;
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+private:
+	struct PacketList
+	{
+		PacketList() : head(NULL), tail(NULL) {}
+		BusPacket *head;
+		BusPacket *tail;
+	};
+	typedef BusPacket *BusPacket::*Link;
+	static void append(PacketList &list, BusPacket *busPacket, Link prev, Link next);
+	static void unlink(PacketList &list, BusPacket *busPacket, Link prev, Link next);
+
+	PacketList packets;
+	vector<PacketList> banks;
+	vector< unordered_map<unsigned, PacketList> > rows;
+	size_t count;
+	uint64_t nextOrder;
+};
+
 class CommandQueue : public SimulatorObject
 {
 	CommandQueue();
 	ostream &dramsim_log;
 public:
 	//typedefs
-	typedef vector<BusPacket *> BusPacket1D;
+	typedef BusPacketQueue BusPacket1D;
 	typedef vector<BusPacket1D> BusPacket2D;
 	typedef vector<BusPacket2D> BusPacket3D;
 
 	//functions
-	CommandQueue(vector< vector<BankState> > &states, ostream &dramsim_log);
+	CommandQueue(vector< vector<BankState> > &states, RecyclingPool<BusPacket> &busPacketPool, ostream &dramsim_log);
 	virtual ~CommandQueue(); 
 
 	void enqueue(BusPacket *newBusPacket);
@@ -71,16 +109,27 @@ public:
 	bool isIssuable(BusPacket *busPacket);
 	bool isEmpty(unsigned rank);
 	void needRefresh(unsigned rank);
+	bool isIdle();
+	void skipIdle(uint64_t cycles);
 	void print();
 	void update(); //SimulatorObject requirement
-	vector<BusPacket *> &getCommandQueue(unsigned rank, unsigned bank);
+	BusPacketQueue &getCommandQueue(unsigned rank, unsigned bank);
 
 	//fields
 	
 	BusPacket3D queues; // 3D array of BusPacket pointers
 	vector< vector<BankState> > &bankStates;
 private:
+	//the memory controller's, for the PRE and REF commands made here
+	RecyclingPool<BusPacket> &busPacketPool;
 	void nextRankAndBank(unsigned &rank, unsigned &bank);
+	bool bankMayIssue(unsigned rank, unsigned bank);
+	bool waitingForActivate(BusPacket *busPacket);
+	BusPacket *firstIssuable(BusPacketQueue &queue, unsigned rank);
+	unsigned queueIndex(unsigned rank, unsigned bank);
+	void queueAt(unsigned index, unsigned &rank, unsigned &bank);
+	unsigned nextNonEmptyQueue(unsigned startingQueue, unsigned offset);
+	void removePacket(BusPacketQueue &queue, BusPacket *busPacket);
 	//fields
 	unsigned nextBank;
 	unsigned nextRank;
@@ -91,9 +140,17 @@ private:
 	unsigned refreshRank;
 	bool refreshWaiting;
 
-	vector< vector<unsigned> > tFAWCountdown;
+	//cycles of each rank's activates within the last tFAW cycles
+	vector< deque<uint64_t> > tFAWActivates;
 	vector< vector<unsigned> > rowAccessCounters;
 
+	//one bit per queue, in round robin order, set while the queue has packets
+	vector<uint64_t> nonEmptyQueues;
+	unsigned numQueues;
+
+	//rows of the column accesses seen so far by firstIssuable()
+	vector<unsigned> rowsSeen;
+
 	bool sendAct;
 };
 }
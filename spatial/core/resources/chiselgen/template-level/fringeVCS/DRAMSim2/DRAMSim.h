@@ -46,7 +46,10 @@ namespace DRAMSim
 		public: 
 			bool addTransaction(bool isWrite, uint64_t addr, uint64_t tag);
 			void setCPUClockSpeed(uint64_t cpuClkFreqHz);
+			unsigned setUpdateThreads(unsigned numThreads);
 			void update();
+			uint64_t cyclesUntilNextEvent();
+			void skipIdle(uint64_t cycles);
 			void printStats(bool finalStats);
 			bool willAcceptTransaction(); 
 			bool willAcceptTransaction(uint64_t addr); 
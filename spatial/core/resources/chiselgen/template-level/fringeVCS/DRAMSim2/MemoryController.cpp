@@ -63,7 +63,7 @@ using namespace DRAMSim;
 MemoryController::MemoryController(MemorySystem *parent, CSVWriter &csvOut_, ostream &dramsim_log_) :
 		dramsim_log(dramsim_log_),
 		bankStates(NUM_RANKS, vector<BankState>(NUM_BANKS, dramsim_log)),
-		commandQueue(bankStates, dramsim_log_),
+		commandQueue(bankStates, busPacketPool, dramsim_log_),
 		poppedBusPacket(NULL),
 		csvOut(csvOut_),
 		totalTransactions(0),
@@ -127,11 +127,11 @@ void MemoryController::receiveFromBus(BusPacket *bpacket)
 	}
 
 	//add to return read data queue
-	returnTransaction.push_back(new Transaction(RETURN_DATA, bpacket->physicalAddress, bpacket->data, bpacket->tag));
+	returnTransaction.push_back(transactionPool.create(RETURN_DATA, bpacket->physicalAddress, bpacket->data, bpacket->tag));
 	totalReadsPerBank[SEQUENTIAL(bpacket->rank,bpacket->bank)]++;
 
-	// this delete statement saves a mindboggling amount of memory
-	delete(bpacket);
+	// recycling the packet here saves a mindboggling amount of memory
+	busPacketPool.recycle(bpacket);
 }
 
 //sends read data back to the CPU
@@ -286,7 +286,7 @@ void MemoryController::update()
 		if (poppedBusPacket->busPacketType == WRITE || poppedBusPacket->busPacketType == WRITE_P)
 		{
 
-			writeDataToSend.push_back(new BusPacket(DATA, poppedBusPacket->physicalAddress, poppedBusPacket->tag,
+			writeDataToSend.push_back(busPacketPool.create(DATA, poppedBusPacket->physicalAddress, poppedBusPacket->tag,
                                           poppedBusPacket->column,
 			                                    poppedBusPacket->row, poppedBusPacket->rank, poppedBusPacket->bank,
 			                                    poppedBusPacket->data, dramsim_log));
@@ -531,13 +531,13 @@ void MemoryController::update()
 			transactionQueue.erase(transactionQueue.begin()+i);
 
 			//create activate command to the row we just translated
-			BusPacket *ACTcommand = new BusPacket(ACTIVATE, transaction->address, transaction->tag,
+			BusPacket *ACTcommand = busPacketPool.create(ACTIVATE, transaction->address, transaction->tag,
 					newTransactionColumn, newTransactionRow, newTransactionRank,
-					newTransactionBank, 0, dramsim_log);
+					newTransactionBank, nullptr, dramsim_log);
 
 			//create read or write command and enqueue it
 			BusPacketType bpType = transaction->getBusPacketType();
-			BusPacket *command = new BusPacket(bpType, transaction->address, transaction->tag,
+			BusPacket *command = busPacketPool.create(bpType, transaction->address, transaction->tag,
 					newTransactionColumn, newTransactionRow, newTransactionRank,
 					newTransactionBank, transaction->data, dramsim_log);
 
@@ -554,8 +554,8 @@ void MemoryController::update()
 			}
 			else
 			{
-				// just delete the transaction now that it's a buspacket
-				delete transaction; 
+				// just recycle the transaction now that it's a buspacket
+				transactionPool.recycle(transaction);
 			}
 			/* only allow one transaction to be scheduled per cycle -- this should
 			 * be a reasonable assumption considering how much logic would be
@@ -685,7 +685,7 @@ void MemoryController::update()
 				//return latency
 				returnReadData(pendingReadTransactions[i]);
 
-				delete pendingReadTransactions[i];
+				transactionPool.recycle(pendingReadTransactions[i]);
 				pendingReadTransactions.erase(pendingReadTransactions.begin()+i);
 				foundMatch=true; 
 				break;
@@ -696,7 +696,7 @@ void MemoryController::update()
 			ERROR("Can't find a matching transaction for 0x"<<hex<<returnTransaction[0]->address<<dec);
 			abort(); 
 		}
-		delete returnTransaction[0];
+		transactionPool.recycle(returnTransaction[0]);
 		returnTransaction.erase(returnTransaction.begin());
 	}
 
@@ -760,6 +760,61 @@ void MemoryController::update()
 
 }
 
+//returns how many of the coming cycles update() would only spend counting
+//	down the refresh counters and adding background energy, which is when
+//	nothing is queued or in flight and every rank is powered down (or idle,
+//	without low power mode); 0 if the next cycle has to be simulated
+//
+//	the ranks themselves are checked by the parent MemorySystem
+uint64_t MemoryController::cyclesUntilNextEvent()
+{
+	//debug output is printed every cycle
+	if (DEBUG_TRANS_Q || DEBUG_CMD_Q || DEBUG_BANKSTATE || DEBUG_POWER)
+	{
+		return 0;
+	}
+
+	if (!transactionQueue.empty() || !returnTransaction.empty() || !pendingReadTransactions.empty() ||
+	        !writeDataToSend.empty() || outgoingCmdPacket != NULL || outgoingDataPacket != NULL ||
+	        !commandQueue.isIdle())
+	{
+		return 0;
+	}
+
+	for (size_t i=0;i<NUM_RANKS;i++)
+	{
+		for (size_t j=0;j<NUM_BANKS;j++)
+		{
+			//an idle rank is powered down in the next cycle in low power mode
+			if (bankStates[i][j].stateChangeCountdown != 0 ||
+			        (bankStates[i][j].currentBankState != PowerDown &&
+			         (bankStates[i][j].currentBankState != Idle || USE_LOW_POWER)))
+			{
+				return 0;
+			}
+		}
+	}
+
+	//a refresh is due when the countdown reaches 0, but a powered down rank
+	//	is woken up tXP cycles before that
+	unsigned countdown = refreshCountdown[refreshRank];
+	unsigned wakeUp = powerDown[refreshRank] ? tXP : 0;
+	return (countdown > wakeUp) ? countdown - wakeUp : 0;
+}
+
+//same as 'cycles' cycles of update() and step(); only valid for up to
+//	cyclesUntilNextEvent() cycles
+void MemoryController::skipIdle(uint64_t cycles)
+{
+	for (size_t i=0;i<NUM_RANKS;i++)
+	{
+		backgroundEnergy[i] += (uint64_t)((powerDown[i] ? IDD2P : IDD2N) * NUM_DEVICES) * cycles;
+		refreshCountdown[i] -= cycles;
+	}
+	commandQueue.skipIdle(cycles);
+	currentClockCycle += cycles;
+}
+
 bool MemoryController::WillAcceptTransaction()
 {
 	return transactionQueue.size() < TRANS_QUEUE_DEPTH;
@@ -960,13 +1015,17 @@ MemoryController::~MemoryController()
 {
 	//ERROR("MEMORY CONTROLLER DESTRUCTOR");
 	//abort();
+	for (size_t i=0; i<transactionQueue.size(); i++)
+	{
+		transactionPool.recycle(transactionQueue[i]);
+	}
 	for (size_t i=0; i<pendingReadTransactions.size(); i++)
 	{
-		delete pendingReadTransactions[i];
+		transactionPool.recycle(pendingReadTransactions[i]);
 	}
 	for (size_t i=0; i<returnTransaction.size(); i++)
 	{
-		delete returnTransaction[i];
+		transactionPool.recycle(returnTransaction[i]);
 	}
 
 }
@@ -45,6 +45,7 @@
 #include "BankState.h"
 #include "Rank.h"
 #include "CSVWriter.h"
+#include "RecyclingPool.h"
 #include <map>
 
 using namespace std;
@@ -66,12 +67,19 @@ public:
 	void receiveFromBus(BusPacket *bpacket);
 	void attachRanks(vector<Rank *> *ranks);
 	void update();
+	uint64_t cyclesUntilNextEvent();
+	void skipIdle(uint64_t cycles);
 	void printStats(bool finalStats = false);
 	void resetStats(); 
 
 
 	//fields
 	vector<Transaction *> transactionQueue;
+
+	//this channel's bus packets and transactions come from (and go back to)
+	//	these, which have to outlive everything holding on to them
+	RecyclingPool<BusPacket> busPacketPool;
+	RecyclingPool<Transaction> transactionPool;
 private:
 	ostream &dramsim_log;
 	vector< vector <BankState> > bankStates;
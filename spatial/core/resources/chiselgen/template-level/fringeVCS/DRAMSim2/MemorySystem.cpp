@@ -155,8 +155,7 @@ MemorySystem::~MemorySystem()
 //	ERROR("MEMORY SYSTEM DESTRUCTOR with ID "<<systemID);
 //	abort();
 
-	delete(memoryController);
-
+	//the ranks hand their packets back to the memory controller's pool, so they go first
 	for (size_t i=0; i<NUM_RANKS; i++)
 	{
 		delete (*ranks)[i];
@@ -164,6 +163,13 @@ MemorySystem::~MemorySystem()
 	ranks->clear();
 	delete(ranks);
 
+	for (size_t i=0; i<pendingTransactions.size(); i++)
+	{
+		memoryController->transactionPool.recycle(pendingTransactions[i]);
+	}
+	pendingTransactions.clear();
+	delete(memoryController);
+
 	if (VERIFICATION_OUTPUT)
 	{
 		cmd_verify_out.flush();
@@ -179,7 +185,7 @@ bool MemorySystem::WillAcceptTransaction()
 bool MemorySystem::addTransaction(bool isWrite, uint64_t addr, uint64_t tag)
 {
 	TransactionType type = isWrite ? DATA_WRITE : DATA_READ;
-	Transaction *trans = new Transaction(type,addr,NULL,tag);
+	Transaction *trans = memoryController->transactionPool.create(type,addr,nullptr,tag);
 	// push_back in memoryController will make a copy of this during
 	// addTransaction so it's kosher for the reference to be local 
 
@@ -238,6 +244,38 @@ void MemorySystem::update()
 	//PRINT("\n"); // two new lines
 }
 
+//number of coming cycles in which update() would not change anything but
+//	the clocks, refresh counters and energy statistics (see
+//	MemoryController::cyclesUntilNextEvent()); 0 if the next cycle has to be
+//	simulated
+uint64_t MemorySystem::cyclesUntilNextEvent()
+{
+	if (pendingTransactions.size() > 0)
+	{
+		return 0;
+	}
+	for (size_t i=0;i<NUM_RANKS;i++)
+	{
+		if (!(*ranks)[i]->isIdle())
+		{
+			return 0;
+		}
+	}
+	return memoryController->cyclesUntilNextEvent();
+}
+
+//same as 'cycles' calls to update(); only valid for up to
+//	cyclesUntilNextEvent() cycles
+void MemorySystem::skipIdle(uint64_t cycles)
+{
+	for (size_t i=0;i<NUM_RANKS;i++)
+	{
+		(*ranks)[i]->skipIdle(cycles);
+	}
+	memoryController->skipIdle(cycles);
+	currentClockCycle += cycles;
+}
+
 void MemorySystem::RegisterCallbacks( Callback_t* readCB, Callback_t* writeCB,
                                       void (*reportPower)(double bgpower, double burstpower,
                                                           double refreshpower, double actprepower))
@@ -58,6 +58,8 @@ public:
 	MemorySystem(unsigned id, unsigned megsOfMemory, CSVWriter &csvOut_, ostream &dramsim_log_);
 	virtual ~MemorySystem();
 	void update();
+	uint64_t cyclesUntilNextEvent();
+	void skipIdle(uint64_t cycles);
 	bool addTransaction(Transaction *trans);
 	bool addTransaction(bool isWrite, uint64_t addr, uint64_t tag);
 	void printStats(bool finalStats);
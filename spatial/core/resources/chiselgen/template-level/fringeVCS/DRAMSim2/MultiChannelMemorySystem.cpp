@@ -42,13 +42,89 @@
 
 using namespace DRAMSim; 
 
+namespace DRAMSim {
+/*
+ * Completions of one channel, recorded while the channels are updated in
+ * parallel and replayed afterwards, channel by channel, so that the
+ * callbacks run in the same order as with a sequential update
+ */
+class ChannelCompletions
+{
+	struct Completion
+	{
+		TransactionCompleteCB *callback;
+		unsigned id;
+		uint64_t address;
+		uint64_t tag;
+		uint64_t cycle;
+	};
+	vector<Completion> log;
+
+	class Recorder : public TransactionCompleteCB
+	{
+		ChannelCompletions *owner;
+		TransactionCompleteCB *callback;
+	public:
+		Recorder(ChannelCompletions *owner_, TransactionCompleteCB *callback_) : owner(owner_), callback(callback_) {}
+		void operator()(unsigned id, uint64_t address, uint64_t tag, uint64_t cycle)
+		{
+			Completion c = {callback, id, address, tag, cycle};
+			owner->log.push_back(c);
+		}
+	};
+	Recorder *readRecorder;
+	Recorder *writeRecorder;
+
+public:
+	ChannelCompletions(TransactionCompleteCB *readDone, TransactionCompleteCB *writeDone) :
+		readRecorder(readDone ? new Recorder(this, readDone) : NULL),
+		writeRecorder(writeDone ? new Recorder(this, writeDone) : NULL)
+	{
+	}
+	~ChannelCompletions()
+	{
+		delete readRecorder;
+		delete writeRecorder;
+	}
+	TransactionCompleteCB *readCallback() { return readRecorder; }
+	TransactionCompleteCB *writeCallback() { return writeRecorder; }
+	void replay()
+	{
+		for (size_t i=0; i<log.size(); i++)
+		{
+			(*log[i].callback)(log[i].id, log[i].address, log[i].tag, log[i].cycle);
+		}
+		log.clear();
+	}
+};
+}
+
+// Waiting threads spin this many times before they yield the CPU, and
+// workers this many times waiting for the next cycle before they sleep
+static const unsigned SPIN_YIELD_LIMIT = 1000;
+static const unsigned WORKER_SPIN_LIMIT = 20000;
+
+static inline void cpuRelax(unsigned spins)
+{
+	if (spins >= SPIN_YIELD_LIMIT)
+	{
+		std::this_thread::yield();
+		return;
+	}
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
 
 MultiChannelMemorySystem::MultiChannelMemorySystem(const string &deviceIniFilename_, const string &systemIniFilename_, const string &pwd_, const string &traceFilename_, unsigned megsOfMemory_, string *visFilename_, const IniReader::OverrideMap *paramOverrides)
 	:megsOfMemory(megsOfMemory_), deviceIniFilename(deviceIniFilename_),
 	systemIniFilename(systemIniFilename_), traceFilename(traceFilename_),
 	pwd(pwd_), visFilename(visFilename_), 
 	clockDomainCrosser(new ClockDomain::Callback<MultiChannelMemorySystem, void>(this, &MultiChannelMemorySystem::actual_update)),
-	csvOut(new CSVWriter(visDataOut))
+	csvOut(new CSVWriter(visDataOut)),
+	numUpdateThreads(1), updateGeneration(0), groupsDone(0), sleepingWorkers(0), stopping(false),
+	readDone(NULL), writeDone(NULL), reportPower(NULL)
 {
 	currentClockCycle=0; 
 	if (visFilename)
@@ -350,11 +426,17 @@ void MultiChannelMemorySystem::mkdirIfNotExist(string path)
 
 MultiChannelMemorySystem::~MultiChannelMemorySystem()
 {
+	stopWorkers();
 	for (size_t i=0; i<NUM_CHANS; i++)
 	{
 		delete channels[i];
 	}
 	channels.clear(); 
+	for (size_t i=0; i<completions.size(); i++)
+	{
+		delete completions[i];
+	}
+	completions.clear();
 
 // flush our streams and close them up
 #ifdef LOG_OUTPUT
@@ -389,13 +471,215 @@ void MultiChannelMemorySystem::actual_update()
 		csvOut->finalize();
 	}
 	
+	updateChannels();
+
+	currentClockCycle++; 
+}
+
+/*
+ * Number of coming calls to update() that would not do anything but count
+ * down DRAM refresh counters, add up background energy and print epoch
+ * statistics, because no transaction is queued or in flight and the ranks are
+ * powered down (or idle, without low power mode). These can be replaced by a
+ * single skipIdle() call; the count is good until the next addTransaction().
+ * 0 if the next update() has to be done.
+ */
+uint64_t MultiChannelMemorySystem::cyclesUntilNextEvent()
+{
+	//the output files are opened by the first update
+	if (currentClockCycle == 0)
+	{
+		return 0;
+	}
+	uint64_t idleCycles = UINT64_MAX;
 	for (size_t i=0; i<NUM_CHANS; i++)
 	{
-		channels[i]->update(); 
+		idleCycles = min(idleCycles, channels[i]->cyclesUntilNextEvent());
+		if (idleCycles == 0)
+		{
+			return 0;
+		}
 	}
+	return clockDomainCrosser.updatesFor(idleCycles);
+}
+
+/*
+ * Same as 'cycles' calls to update(), in closed form; only valid for up to
+ * cyclesUntilNextEvent() calls. Epoch statistics crossed on the way are
+ * printed as update() would.
+ */
+void MultiChannelMemorySystem::skipIdle(uint64_t cycles)
+{
+	uint64_t dramCycles = clockDomainCrosser.skip(cycles);
+	while (dramCycles > 0)
+	{
+		if (currentClockCycle % EPOCH_LENGTH == 0)
+		{
+			(*csvOut) << "ms" <<currentClockCycle * tCK * 1E-6; 
+			for (size_t i=0; i<NUM_CHANS; i++)
+			{
+				channels[i]->printStats(false); 
+			}
+			csvOut->finalize();
+		}
 
+		uint64_t stretch = min(dramCycles, EPOCH_LENGTH - currentClockCycle % EPOCH_LENGTH);
+		for (size_t i=0; i<NUM_CHANS; i++)
+		{
+			channels[i]->skipIdle(stretch);
+		}
+		currentClockCycle += stretch;
+		dramCycles -= stretch;
+	}
+}
 
-	currentClockCycle++; 
+/*
+ * Update the channels on up to 'numThreads' threads (1 == sequentially, the
+ * default); returns the number of threads used. Channels share nothing
+ * within a cycle; their completion callbacks are deferred to the end of the
+ * cycle and run in channel order, so the results are the same as with a
+ * sequential update. Worthwhile with many channels and spare cores: there
+ * are never more threads than channels or cores. Debug and verification
+ * output, which all channels write to the same streams, forces a
+ * sequential update.
+ */
+unsigned MultiChannelMemorySystem::setUpdateThreads(unsigned numThreads)
+{
+	stopWorkers();
+	unsigned cores = std::thread::hardware_concurrency();
+	if (cores > 0 && numThreads > cores)
+	{
+		numThreads = cores;
+	}
+	if (numThreads > NUM_CHANS)
+	{
+		numThreads = NUM_CHANS;
+	}
+	if (numThreads > 1 && (DEBUG_TRANS_Q || DEBUG_CMD_Q || DEBUG_ADDR_MAP || DEBUG_BANKSTATE || DEBUG_BUS || DEBUG_BANKS || DEBUG_POWER || VERIFICATION_OUTPUT))
+	{
+		DEBUG("== Debug or verification output is on, updating channels sequentially ==");
+		numThreads = 1;
+	}
+	numUpdateThreads = (numThreads == 0) ? 1 : numThreads;
+	registerChannelCallbacks();
+	startWorkers();
+	return numUpdateThreads;
+}
+
+void MultiChannelMemorySystem::updateChannelGroup(unsigned group)
+{
+	for (size_t i=group; i<NUM_CHANS; i+=numUpdateThreads)
+	{
+		channels[i]->update();
+	}
+}
+
+void MultiChannelMemorySystem::updateChannels()
+{
+	if (numUpdateThreads == 1)
+	{
+		for (size_t i=0; i<NUM_CHANS; i++)
+		{
+			channels[i]->update(); 
+		}
+		return;
+	}
+
+	groupsDone.store(0);
+	updateGeneration++;
+	if (sleepingWorkers.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		wakeCond.notify_all();
+	}
+	updateChannelGroup(0);
+	for (unsigned spins=0; groupsDone.load() < numUpdateThreads - 1; spins++)
+	{
+		cpuRelax(spins);
+	}
+
+	for (size_t i=0; i<NUM_CHANS; i++)
+	{
+		completions[i]->replay();
+	}
+}
+
+void MultiChannelMemorySystem::workerLoop(unsigned group)
+{
+	uint64_t seen = updateGeneration.load();
+	while (true)
+	{
+		// Spin for a while for the next cycle, then sleep until woken
+		unsigned spins = 0;
+		while (updateGeneration.load() == seen && !stopping.load())
+		{
+			if (++spins < WORKER_SPIN_LIMIT)
+			{
+				cpuRelax(spins);
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(wakeMutex);
+			sleepingWorkers++;
+			wakeCond.wait(lock, [&]{ return updateGeneration.load() != seen || stopping.load(); });
+			sleepingWorkers--;
+		}
+		if (stopping.load())
+		{
+			return;
+		}
+		seen++;
+		updateChannelGroup(group);
+		groupsDone++;
+	}
+}
+
+void MultiChannelMemorySystem::startWorkers()
+{
+	stopping.store(false);
+	for (unsigned g=1; g<numUpdateThreads; g++)
+	{
+		workers.push_back(std::thread(&MultiChannelMemorySystem::workerLoop, this, g));
+	}
+}
+
+void MultiChannelMemorySystem::stopWorkers()
+{
+	if (workers.empty())
+	{
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		stopping.store(true);
+		wakeCond.notify_all();
+	}
+	for (size_t i=0; i<workers.size(); i++)
+	{
+		workers[i].join();
+	}
+	workers.clear();
+}
+
+// Channels report completions directly, or through ChannelCompletions when updated in parallel
+void MultiChannelMemorySystem::registerChannelCallbacks()
+{
+	for (size_t i=0; i<completions.size(); i++)
+	{
+		delete completions[i];
+	}
+	completions.clear();
+	for (size_t i=0; i<NUM_CHANS; i++)
+	{
+		if (numUpdateThreads > 1)
+		{
+			completions.push_back(new ChannelCompletions(readDone, writeDone));
+			channels[i]->RegisterCallbacks(completions[i]->readCallback(), completions[i]->writeCallback(), reportPower);
+		}
+		else
+		{
+			channels[i]->RegisterCallbacks(readDone, writeDone, reportPower);
+		}
+	}
 }
 unsigned MultiChannelMemorySystem::findChannelNumber(uint64_t addr)
 {
@@ -492,10 +776,10 @@ void MultiChannelMemorySystem::RegisterCallbacks(
 		TransactionCompleteCB *writeDone,
 		void (*reportPower)(double bgpower, double burstpower, double refreshpower, double actprepower))
 {
-	for (size_t i=0; i<NUM_CHANS; i++)
-	{
-		channels[i]->RegisterCallbacks(readDone, writeDone, reportPower); 
-	}
+	this->readDone = readDone;
+	this->writeDone = writeDone;
+	this->reportPower = reportPower;
+	registerChannelCallbacks();
 }
 
 /*
@@ -34,10 +34,16 @@
 #include "IniReader.h"
 #include "ClockDomain.h"
 #include "CSVWriter.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 
 namespace DRAMSim {
 
+class ChannelCompletions;
+
 
 class MultiChannelMemorySystem : public SimulatorObject 
 {
@@ -51,6 +57,8 @@ class MultiChannelMemorySystem : public SimulatorObject
 			bool willAcceptTransaction(); 
 			bool willAcceptTransaction(uint64_t addr); 
 			void update();
+			uint64_t cyclesUntilNextEvent();
+			void skipIdle(uint64_t cycles);
 			void printStats(bool finalStats=false);
 			ostream &getLogFile();
 			void RegisterCallbacks( 
@@ -64,6 +72,7 @@ class MultiChannelMemorySystem : public SimulatorObject
 
 	void InitOutputFiles(string tracefilename);
 	void setCPUClockSpeed(uint64_t cpuClkFreqHz);
+	unsigned setUpdateThreads(unsigned numThreads);
 
 	//output file
 	std::ofstream visDataOut;
@@ -84,6 +93,27 @@ class MultiChannelMemorySystem : public SimulatorObject
 		static bool fileExists(string path); 
 		CSVWriter *csvOut; 
 
+		// Parallel channel update (see setUpdateThreads): thread g updates
+		// channels g, g+numUpdateThreads, ...; thread 0 is the caller's
+		void updateChannels();
+		void updateChannelGroup(unsigned group);
+		void workerLoop(unsigned group);
+		void startWorkers();
+		void stopWorkers();
+		void registerChannelCallbacks();
+		unsigned numUpdateThreads;
+		vector<std::thread> workers;
+		std::atomic<uint64_t> updateGeneration;
+		std::atomic<unsigned> groupsDone;
+		std::atomic<unsigned> sleepingWorkers;
+		std::atomic<bool> stopping;
+		std::mutex wakeMutex;
+		std::condition_variable wakeCond;
+		vector<ChannelCompletions*> completions;
+		TransactionCompleteCB *readDone;
+		TransactionCompleteCB *writeDone;
+		void (*reportPower)(double bgpower, double burstpower, double refreshpower, double actprepower);
+
 
 	};
 }
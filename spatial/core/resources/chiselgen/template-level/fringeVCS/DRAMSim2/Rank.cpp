@@ -74,10 +74,13 @@ Rank::~Rank()
 {
 	for (size_t i=0; i<readReturnPacket.size(); i++)
 	{
-		delete readReturnPacket[i];
+		memoryController->busPacketPool.recycle(readReturnPacket[i]);
 	}
 	readReturnPacket.clear(); 
-	delete outgoingDataPacket; 
+	if (outgoingDataPacket != NULL)
+	{
+		memoryController->busPacketPool.recycle(outgoingDataPacket);
+	}
 }
 void Rank::receiveFromBus(BusPacket *packet)
 {
@@ -174,7 +177,7 @@ void Rank::receiveFromBus(BusPacket *packet)
 		incomingWriteBank = packet->bank;
 		incomingWriteRow = packet->row;
 		incomingWriteColumn = packet->column;
-		delete(packet);
+		memoryController->busPacketPool.recycle(packet);
 		break;
 	case WRITE_P:
 		//make sure a write is allowed
@@ -199,7 +202,7 @@ void Rank::receiveFromBus(BusPacket *packet)
 		incomingWriteBank = packet->bank;
 		incomingWriteRow = packet->row;
 		incomingWriteColumn = packet->column;
-		delete(packet);
+		memoryController->busPacketPool.recycle(packet);
 		break;
 	case ACTIVATE:
 		//make sure activate is allowed
@@ -236,7 +239,7 @@ void Rank::receiveFromBus(BusPacket *packet)
 				bankStates[i].nextActivate = max(bankStates[i].nextActivate, currentClockCycle + tRRD);
 			}
 		}
-		delete(packet); 
+		memoryController->busPacketPool.recycle(packet); 
 		break;
 	case PRECHARGE:
 		//make sure precharge is allowed
@@ -249,7 +252,7 @@ void Rank::receiveFromBus(BusPacket *packet)
 
 		bankStates[packet->bank].currentBankState = Idle;
 		bankStates[packet->bank].nextActivate = max(bankStates[packet->bank].nextActivate, currentClockCycle + tRP);
-		delete(packet); 
+		memoryController->busPacketPool.recycle(packet); 
 		break;
 	case REFRESH:
 		refreshWaiting = false;
@@ -262,7 +265,7 @@ void Rank::receiveFromBus(BusPacket *packet)
 			}
 			bankStates[i].nextActivate = currentClockCycle + tRFC;
 		}
-		delete(packet); 
+		memoryController->busPacketPool.recycle(packet); 
 		break;
 	case DATA:
 		// TODO: replace this check with something that works?
@@ -282,7 +285,7 @@ void Rank::receiveFromBus(BusPacket *packet)
 #else
 		// end of the line for the write packet
 #endif
-		delete(packet);
+		memoryController->busPacketPool.recycle(packet);
 		break;
 	default:
 		ERROR("== Error - Unknown BusPacketType trying to be sent to Bank");
@@ -341,6 +344,19 @@ void Rank::update()
 	}
 }
 
+//true if no read data is waiting to go out or on the bus and no refresh is
+//	waiting, so that update() has nothing to do
+bool Rank::isIdle()
+{
+	return readReturnPacket.empty() && outgoingDataPacket == NULL && !refreshWaiting;
+}
+
+//same as 'cycles' cycles of update() and step() while idle
+void Rank::skipIdle(uint64_t cycles)
+{
+	currentClockCycle += cycles;
+}
+
 //power down the rank
 void Rank::powerDown()
 {
@@ -65,6 +65,8 @@ public:
 	int getId() const;
 	void setId(int id);
 	void update();
+	bool isIdle();
+	void skipIdle(uint64_t cycles);
 	void powerUp();
 	void powerDown();
 
@@ -0,0 +1,72 @@
+#ifndef RECYCLINGPOOL_H
+#define RECYCLINGPOOL_H
+
+//RecyclingPool.h
+//
+//Header file for recycling pool
+//
+
+#include <new>
+#include <vector>
+#include <utility>
+
+namespace DRAMSim
+{
+/**
+ * Free list for the objects a channel creates and destroys every few
+ * cycles (bus packets and transactions), so that they are not allocated
+ * on the heap each time. Objects are created with create() in place of
+ * new, and handed back with recycle() in place of delete. Memory is only
+ * returned to the heap when the pool goes away, so the pool has to outlive
+ * its objects.
+ *
+ * recycle() also takes objects that were allocated with a plain new (such
+ * as transactions passed in to addTransaction()).
+ *
+ * A pool is not thread safe: each channel has its own, only used from that
+ * channel's update() or between updates.
+ */
+template <typename T>
+class RecyclingPool
+{
+public:
+	RecyclingPool() {}
+	~RecyclingPool()
+	{
+		for (size_t i=0;i<freeObjects.size();i++)
+		{
+			::operator delete(freeObjects[i]);
+		}
+	}
+
+	template <typename... Args>
+	T *create(Args&&... args)
+	{
+		void *memory;
+		if (freeObjects.empty())
+		{
+			memory = ::operator new(sizeof(T));
+		}
+		else
+		{
+			memory = freeObjects.back();
+			freeObjects.pop_back();
+		}
+		return new (memory) T(std::forward<Args>(args)...);
+	}
+
+	void recycle(T *object)
+	{
+		object->~T();
+		freeObjects.push_back(object);
+	}
+
+private:
+	RecyclingPool(const RecyclingPool &);
+	RecyclingPool &operator=(const RecyclingPool &);
+
+	std::vector<void *> freeObjects;
+};
+}
+
+#endif
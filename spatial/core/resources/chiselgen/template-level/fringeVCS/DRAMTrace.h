@@ -0,0 +1,178 @@
+#ifndef __DRAM_TRACE_H
+#define __DRAM_TRACE_H
+
+#include <cstring>
+#include <cstdlib>
+#include <stdio.h>
+#include <stdint.h>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+using namespace std;
+
+#include "commonDefs.h"
+
+/**
+ * Binary DRAM trace format
+ * A file is one DRAMTraceHeader followed by fixed-width DRAMTraceRecords,
+ * one per completed burst, in completion order. All fields are little-endian.
+ * Use 'tools/DRAMTraceReader' to print the records in the legacy text format
+ * or to summarize latency and bandwidth.
+ */
+#define DRAM_TRACE_MAGIC    "DRAMTRC1"
+#define DRAM_TRACE_VERSION  1
+
+enum DRAMTraceType { TRACE_LOAD = 0, TRACE_STORE = 1 };
+enum DRAMTraceSource { TRACE_DRAMSIM = 0, TRACE_N3XT = 1 };
+
+struct DRAMTraceHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t recordSize;
+  uint32_t source;        // DRAMTraceSource
+  uint32_t burstSizeBytes;
+};
+
+struct DRAMTraceRecord {
+  uint64_t id;
+  uint64_t issued;     // Cycle at which the burst was issued
+  uint64_t addr;       // Accelerator-visible (small) address
+  uint32_t latency;    // Cycles from issue to response
+  uint32_t size;       // Bytes
+  uint32_t channel;
+  uint32_t type;       // DRAMTraceType
+};
+
+static_assert(sizeof(DRAMTraceRecord) == 40, "DRAMTraceRecord must stay fixed-width");
+
+/**
+ * Buffered trace writer. Records are appended to an in-memory buffer on the
+ * simulation thread; full buffers are handed to a background thread that
+ * writes them out, so the simulator never blocks on file I/O unless the
+ * writer falls behind by more than 'maxPending' buffers.
+ */
+class DRAMTraceWriter {
+  FILE *fp = NULL;
+  string filename;
+  size_t recordsPerBuffer;
+  const size_t maxPending = 4;
+
+  vector<DRAMTraceRecord> *cur = NULL;
+  deque<vector<DRAMTraceRecord>*> pending;   // Full buffers waiting to be written
+  deque<vector<DRAMTraceRecord>*> freeBufs;  // Written buffers available for reuse
+  mutex m;
+  condition_variable cvPending;
+  condition_variable cvFree;
+  thread writer;
+  bool done = false;
+
+  void writerLoop() {
+    while (true) {
+      vector<DRAMTraceRecord> *buf = NULL;
+      {
+        unique_lock<mutex> lock(m);
+        cvPending.wait(lock, [this] { return done || !pending.empty(); });
+        if (pending.empty()) break;  // done and drained
+        buf = pending.front();
+        pending.pop_front();
+      }
+
+      size_t n = fwrite(&(*buf)[0], sizeof(DRAMTraceRecord), buf->size(), fp);
+      ASSERT(n == buf->size(), "[DRAMTraceWriter] Error writing to '%s'\n", filename.c_str());
+      buf->clear();
+
+      {
+        unique_lock<mutex> lock(m);
+        freeBufs.push_back(buf);
+      }
+      cvFree.notify_one();
+    }
+  }
+
+  vector<DRAMTraceRecord>* getFreeBuffer() {
+    unique_lock<mutex> lock(m);
+    if (freeBufs.empty() && (pending.size() < maxPending)) {
+      vector<DRAMTraceRecord> *buf = new vector<DRAMTraceRecord>();
+      buf->reserve(recordsPerBuffer);
+      return buf;
+    }
+    cvFree.wait(lock, [this] { return !freeBufs.empty(); });
+    vector<DRAMTraceRecord> *buf = freeBufs.front();
+    freeBufs.pop_front();
+    return buf;
+  }
+
+  void submit() {
+    if (cur->empty()) return;
+    {
+      unique_lock<mutex> lock(m);
+      pending.push_back(cur);
+    }
+    cvPending.notify_one();
+    cur = NULL;
+  }
+
+public:
+  uint64_t numRecords = 0;
+
+  DRAMTraceWriter(string filename, DRAMTraceSource source, uint32_t burstSizeBytes, size_t bufferBytes = 4 << 20) : filename(filename) {
+    fp = fopen(filename.c_str(), "wb");
+    ASSERT(fp != NULL, "Unable to open file %s!\n", filename.c_str());
+
+    DRAMTraceHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DRAM_TRACE_MAGIC, sizeof(header.magic));
+    header.version = DRAM_TRACE_VERSION;
+    header.recordSize = sizeof(DRAMTraceRecord);
+    header.source = source;
+    header.burstSizeBytes = burstSizeBytes;
+    fwrite(&header, sizeof(header), 1, fp);
+
+    recordsPerBuffer = bufferBytes / sizeof(DRAMTraceRecord);
+    cur = getFreeBuffer();
+    writer = thread(&DRAMTraceWriter::writerLoop, this);
+  }
+
+  void append(uint64_t id, uint64_t issued, uint64_t addr, uint32_t latency, uint32_t size, uint32_t channel, DRAMTraceType type) {
+    if (cur == NULL) cur = getFreeBuffer();
+    DRAMTraceRecord r;
+    r.id = id;
+    r.issued = issued;
+    r.addr = addr;
+    r.latency = latency;
+    r.size = size;
+    r.channel = channel;
+    r.type = type;
+    cur->push_back(r);
+    numRecords++;
+    if (cur->size() >= recordsPerBuffer) submit();
+  }
+
+  // Flush outstanding records and close the file
+  void close() {
+    if (fp == NULL) return;
+    if (cur != NULL) submit();
+    {
+      unique_lock<mutex> lock(m);
+      done = true;
+    }
+    cvPending.notify_one();
+    writer.join();
+    fclose(fp);
+    fp = NULL;
+
+    if (cur != NULL) delete cur;
+    while (!freeBufs.empty()) {
+      delete freeBufs.front();
+      freeBufs.pop_front();
+    }
+  }
+
+  ~DRAMTraceWriter() {
+    close();
+  }
+};
+
+#endif // __DRAM_TRACE_H
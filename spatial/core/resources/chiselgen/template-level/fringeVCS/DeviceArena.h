@@ -0,0 +1,403 @@
+#ifndef __DEVICE_ARENA_H
+#define __DEVICE_ARENA_H
+
+#include <cstring>
+#include <cstdlib>
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <vector>
+#include <unordered_map>
+#include <map>
+#include <sys/mman.h>
+#include <sys/stat.h>
+using namespace std;
+
+#include "commonDefs.h"
+
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB 0x40000
+#endif
+#ifndef MADV_REMOVE
+#define MADV_REMOVE 9
+#endif
+
+/**
+ * Device (accelerator DRAM) memory arena
+ * One virtual range is reserved up front and all MALLOCs are carved out of
+ * it, instead of one private mapping per allocation. The range is 2 MB
+ * aligned and backed by transparent hugepages (or explicit hugetlbfs pages),
+ * so bursts spread over a large buffer need few TLB entries.
+ * - Small blocks (up to 1 MB) are a power of two in size, at least one 4 KB
+ *   page; each size class has its own free list, so alloc and free are O(1).
+ *   Unused tails of blocks cost address space only, not memory, until touched.
+ * - Larger blocks are a multiple of the hugepage size, taken from a free list
+ *   of ranges (first fit); adjacent free ranges are merged, so large buffers
+ *   waste at most part of one hugepage and freed space is not fragmented.
+ * - Freed blocks are returned to the kernel (MADV_DONTNEED), so reused
+ *   blocks read as zero like a fresh mapping.
+ * - The arena can instead map a file shared with the host process (a memfd
+ *   created by FringeContextVCS). Both processes then see the same device
+ *   memory, and the host addresses it by offset from the start of the arena.
+ */
+class DeviceArena {
+public:
+  enum HugePageMode { HUGEPAGES_NONE = 0, HUGEPAGES_TRANSPARENT = 1, HUGEPAGES_EXPLICIT = 2 };
+
+  static const uint32_t hugeClass = 21;  // 2 MB
+  static const size_t hugePageSize = 1ULL << hugeClass;
+  static const uint32_t minClass = 12;   // 4 KB
+  static const uint32_t numClasses = hugeClass;   // Size classes below a hugepage
+
+private:
+  uint8_t *base = NULL;
+  size_t capacity = 0;
+  size_t reserved = 0;     // Bytes mapped, including alignment slack
+  uint8_t *mapping = NULL;
+  size_t top = 0;          // Bump pointer: offset of the first never-allocated byte
+  HugePageMode mode;
+  int sharedFd = -1;       // File backing a shared arena, -1 == private anonymous memory
+
+  vector<uint8_t*> freeBlocks[numClasses];
+  map<uint64_t, uint64_t> freeRanges;            // Offset -> bytes, of free hugepage ranges
+  unordered_map<uint64_t, uint64_t> blockSize;   // Live block -> bytes
+
+  static uint32_t sizeClass(size_t size) {
+    uint32_t c = minClass;
+    while ((1ULL << c) < size) c++;
+    return c;
+  }
+
+  // Returns the offset of 'bytes' (a multiple of the hugepage size) free bytes, or 'capacity' if there are none
+  uint64_t allocRange(uint64_t bytes) {
+    for (map<uint64_t, uint64_t>::iterator it = freeRanges.begin(); it != freeRanges.end(); it++) {
+      if (it->second >= bytes) {
+        uint64_t offset = it->first;
+        uint64_t remaining = it->second - bytes;
+        freeRanges.erase(it);
+        if (remaining > 0) {
+          freeRanges[offset + bytes] = remaining;
+        }
+        numReused++;
+        return offset;
+      }
+    }
+    uint64_t offset = (top + hugePageSize - 1) & ~(uint64_t)(hugePageSize - 1);
+    if (offset + bytes > capacity) return capacity;
+    top = offset + bytes;
+    return offset;
+  }
+
+  void freeRange(uint64_t offset, uint64_t bytes) {
+    uint64_t end = offset + bytes;
+
+    // Merge with the following free range, then with the preceding one
+    map<uint64_t, uint64_t>::iterator next = freeRanges.lower_bound(offset);
+    if ((next != freeRanges.end()) && (next->first == end)) {
+      bytes += next->second;
+      end += next->second;
+      freeRanges.erase(next);
+    }
+    map<uint64_t, uint64_t>::iterator prev = freeRanges.lower_bound(offset);
+    if (prev != freeRanges.begin()) {
+      prev--;
+      if (prev->first + prev->second == offset) {
+        offset = prev->first;
+        bytes += prev->second;
+        freeRanges.erase(prev);
+      }
+    }
+
+    // A range at the top of the allocated space is returned to it instead
+    if (end == top) {
+      top = offset;
+    } else {
+      freeRanges[offset] = bytes;
+    }
+  }
+
+public:
+  size_t bytesLive = 0;
+  size_t peakBytesLive = 0;
+  uint64_t numAllocs = 0;
+  uint64_t numReused = 0;
+
+  DeviceArena(size_t capacityBytes, HugePageMode hugePages, int fd = -1) {
+    capacity = (capacityBytes + hugePageSize - 1) & ~(hugePageSize - 1);
+    mode = hugePages;
+
+    void *ptr = MAP_FAILED;
+    if (fd >= 0) {
+      mapShared(fd);
+      return;
+    }
+    if (mode == HUGEPAGES_EXPLICIT) {
+      // Reserve the hugepages now (no MAP_NORESERVE): a pool that is too small fails here instead of with SIGBUS later
+      ptr = mmap(0, capacity, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+      if (ptr == MAP_FAILED) {
+        EPRINTF("[DeviceArena] Unable to map %lu MB of hugetlbfs pages, falling back to transparent hugepages\n", capacity >> 20);
+        mode = HUGEPAGES_TRANSPARENT;
+      } else {
+        mapping = base = (uint8_t*) ptr;
+        reserved = capacity;
+      }
+    }
+    if (ptr == MAP_FAILED) {
+      // Over-reserve by one hugepage so that the arena can start on a hugepage boundary
+      reserved = capacity + hugePageSize;
+      ptr = mmap(0, reserved, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+      ASSERT(ptr != MAP_FAILED, "[DeviceArena] Unable to reserve %lu MB of device memory\n", capacity >> 20);
+      mapping = (uint8_t*) ptr;
+      base = (uint8_t*) (((uint64_t)mapping + hugePageSize - 1) & ~(uint64_t)(hugePageSize - 1));
+      if (mode == HUGEPAGES_TRANSPARENT) {
+        if (madvise(base, capacity, MADV_HUGEPAGE) != 0) {
+          EPRINTF("[DeviceArena] Transparent hugepages unavailable, using 4 KB pages\n");
+          mode = HUGEPAGES_NONE;
+        }
+      }
+    }
+  }
+
+  /**
+   * Map all of 'fd' as the arena. The file's creator sized it (a multiple of
+   * the hugepage size) and chose its page size: files on hugetlbfs are
+   * already backed by hugepages, others get transparent hugepages if shmem
+   * allows them.
+   */
+  void mapShared(int fd) {
+    struct stat st;
+    ASSERT(fstat(fd, &st) == 0, "[DeviceArena] Unable to stat shared device memory (fd %d): %s\n", fd, strerror(errno));
+    capacity = (size_t)st.st_size & ~(hugePageSize - 1);
+    ASSERT(capacity > 0, "[DeviceArena] Shared device memory (fd %d) is smaller than a hugepage\n", fd);
+
+    // Reserve an aligned range, then map the file over its hugepage-aligned part
+    reserved = capacity + hugePageSize;
+    void *ptr = mmap(0, reserved, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+    ASSERT(ptr != MAP_FAILED, "[DeviceArena] Unable to reserve %lu MB of device memory\n", capacity >> 20);
+    mapping = (uint8_t*) ptr;
+    base = (uint8_t*) (((uint64_t)mapping + hugePageSize - 1) & ~(uint64_t)(hugePageSize - 1));
+    ptr = mmap(base, capacity, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_FIXED|MAP_NORESERVE, fd, 0);
+    ASSERT(ptr != MAP_FAILED, "[DeviceArena] Unable to map %lu MB of shared device memory: %s\n", capacity >> 20, strerror(errno));
+    sharedFd = fd;
+
+    if ((size_t)st.st_blksize >= hugePageSize) {
+      mode = HUGEPAGES_EXPLICIT;
+    } else if (mode != HUGEPAGES_NONE) {
+      mode = (madvise(base, capacity, MADV_HUGEPAGE) == 0) ? HUGEPAGES_TRANSPARENT : HUGEPAGES_NONE;
+    }
+  }
+
+  // Touch every page so that no page faults happen during simulation
+  void prefault() {
+    size_t step = (mode == HUGEPAGES_NONE) ? 4096 : hugePageSize;
+    for (size_t offset = 0; offset < capacity; offset += step) {
+      base[offset] = 0;
+    }
+  }
+
+  const char* modeName() {
+    switch (mode) {
+      case HUGEPAGES_EXPLICIT: return "hugetlbfs";
+      case HUGEPAGES_TRANSPARENT: return "transparent hugepages";
+      default: return "4 KB pages";
+    }
+  }
+
+  size_t size() {
+    return capacity;
+  }
+
+  bool isShared() {
+    return sharedFd >= 0;
+  }
+
+  // Offset of 'ptr' into the arena, which is where the host finds it in a shared arena
+  uint64_t offsetOf(void *ptr) {
+    return (uint64_t)((uint8_t*)ptr - base);
+  }
+
+  void* pointerAt(uint64_t offset) {
+    return base + offset;
+  }
+
+  bool contains(void *ptr, size_t size) {
+    return ((uint8_t*)ptr >= base) && ((uint8_t*)ptr + size <= base + capacity);
+  }
+
+  // Returns NULL if the arena is exhausted
+  void* alloc(size_t size) {
+    uint32_t c = sizeClass(size);
+    uint64_t bytes;
+    uint8_t *ptr = NULL;
+    if (c >= hugeClass) {
+      bytes = (size + hugePageSize - 1) & ~(uint64_t)(hugePageSize - 1);
+      uint64_t offset = allocRange(bytes);
+      if (offset == capacity) return NULL;
+      ptr = base + offset;
+    } else if (!freeBlocks[c].empty()) {
+      bytes = 1ULL << c;
+      ptr = freeBlocks[c].back();
+      freeBlocks[c].pop_back();
+      numReused++;
+    } else {
+      // Fresh small blocks start on a boundary of their size
+      bytes = 1ULL << c;
+      size_t offset = (top + bytes - 1) & ~(bytes - 1);
+      if (offset + bytes > capacity) return NULL;
+      ptr = base + offset;
+      top = offset + bytes;
+    }
+    blockSize[(uint64_t)ptr] = bytes;
+    bytesLive += bytes;
+    if (bytesLive > peakBytesLive) peakBytesLive = bytesLive;
+    numAllocs++;
+    return ptr;
+  }
+
+  // Returns false if 'ptr' was not returned by alloc()
+  bool free(void *ptr) {
+    unordered_map<uint64_t, uint64_t>::iterator it = blockSize.find((uint64_t)ptr);
+    if (it == blockSize.end()) return false;
+    uint64_t bytes = it->second;
+    blockSize.erase(it);
+    // Dropping the pages of a shared mapping does not discard its contents; remove them from the file instead
+    if (madvise(ptr, bytes, isShared() ? MADV_REMOVE : MADV_DONTNEED) != 0) {
+      memset(ptr, 0, bytes);
+    }
+    if (bytes >= hugePageSize) {
+      freeRange(offsetOf(ptr), bytes);
+    } else {
+      freeBlocks[sizeClass(bytes)].push_back((uint8_t*)ptr);
+    }
+    bytesLive -= bytes;
+    return true;
+  }
+
+  /**
+   * Checkpoint: the allocator state, then every page below the high-water
+   * mark that is not all zero, as (offset, page) records ending with
+   * offset UINT64_MAX. Returns false on a write error.
+   */
+  bool save(FILE *f) {
+    const size_t pageSize = 1ULL << minClass;
+    static const uint8_t zeroPage[1 << minClass] = {0};
+    uint64_t header[4] = { capacity, top, blockSize.size(), freeRanges.size() };
+    if (fwrite(header, sizeof(header), 1, f) != 1) return false;
+    for (unordered_map<uint64_t, uint64_t>::iterator it = blockSize.begin(); it != blockSize.end(); it++) {
+      uint64_t block[2] = { offsetOf((void*)it->first), it->second };
+      if (fwrite(block, sizeof(block), 1, f) != 1) return false;
+    }
+    for (map<uint64_t, uint64_t>::iterator it = freeRanges.begin(); it != freeRanges.end(); it++) {
+      uint64_t range[2] = { it->first, it->second };
+      if (fwrite(range, sizeof(range), 1, f) != 1) return false;
+    }
+    for (uint32_t c = 0; c < numClasses; c++) {
+      uint64_t numFree = freeBlocks[c].size();
+      if (fwrite(&numFree, sizeof(numFree), 1, f) != 1) return false;
+      for (size_t i = 0; i < freeBlocks[c].size(); i++) {
+        uint64_t offset = offsetOf(freeBlocks[c][i]);
+        if (fwrite(&offset, sizeof(offset), 1, f) != 1) return false;
+      }
+    }
+    for (uint64_t offset = 0; offset < top; offset += pageSize) {
+      if (memcmp(base + offset, zeroPage, pageSize) == 0) continue;
+      if ((fwrite(&offset, sizeof(offset), 1, f) != 1) || (fwrite(base + offset, pageSize, 1, f) != 1)) return false;
+    }
+    uint64_t end = UINT64_MAX;
+    return fwrite(&end, sizeof(end), 1, f) == 1;
+  }
+
+  /**
+   * Restore a checkpoint written by save() into an arena that has not
+   * allocated anything yet, and that is at least as large as the saved
+   * high-water mark. Returns false on a read error or a mismatch.
+   */
+  bool load(FILE *f) {
+    const size_t pageSize = 1ULL << minClass;
+    uint64_t header[4];
+    if (fread(header, sizeof(header), 1, f) != 1) return false;
+    if ((top != 0) || !blockSize.empty() || (header[1] > capacity)) return false;
+    top = header[1];
+    for (uint64_t i = 0; i < header[2]; i++) {
+      uint64_t block[2];
+      if (fread(block, sizeof(block), 1, f) != 1) return false;
+      blockSize[(uint64_t)(base + block[0])] = block[1];
+      bytesLive += block[1];
+    }
+    peakBytesLive = bytesLive;
+    numAllocs = header[2];
+    for (uint64_t i = 0; i < header[3]; i++) {
+      uint64_t range[2];
+      if (fread(range, sizeof(range), 1, f) != 1) return false;
+      freeRanges[range[0]] = range[1];
+    }
+    for (uint32_t c = 0; c < numClasses; c++) {
+      uint64_t numFree;
+      if (fread(&numFree, sizeof(numFree), 1, f) != 1) return false;
+      for (uint64_t i = 0; i < numFree; i++) {
+        uint64_t offset;
+        if (fread(&offset, sizeof(offset), 1, f) != 1) return false;
+        freeBlocks[c].push_back(base + offset);
+      }
+    }
+    while (true) {
+      uint64_t offset;
+      if (fread(&offset, sizeof(offset), 1, f) != 1) return false;
+      if (offset == UINT64_MAX) return true;
+      if ((offset + pageSize > top) || (fread(base + offset, pageSize, 1, f) != 1)) return false;
+    }
+  }
+
+  void printStats() {
+    EPRINTF("[DeviceArena] %lu MB%s, %s: %lu allocs (%lu reused), %lu MB live, %lu MB peak, %lu MB high-water mark\n",
+      capacity >> 20, isShared() ? " shared" : "", modeName(), numAllocs, numReused, bytesLive >> 20, peakBytesLive >> 20, top >> 20);
+  }
+
+  ~DeviceArena() {
+    munmap(mapping, reserved);
+  }
+};
+
+/**
+ * Create the device memory arena from the environment:
+ *   DRAM_ARENA_SIZE_MB    Size cap (default 4096, the accelerator's 32-bit address space)
+ *   DRAM_ARENA_HUGEPAGES  0 = 4 KB pages, 1 = transparent hugepages (default), 2 = hugetlbfs
+ *   DRAM_ARENA_PREFAULT   1 = touch the whole arena at startup
+ * If 'sharedFd' is an open file, the arena maps it instead, and takes its
+ * size and page size from the file.
+ */
+DeviceArena* initDeviceArena(int sharedFd = -1) {
+  size_t sizeMB = 4096;
+  char *sizeVar = getenv("DRAM_ARENA_SIZE_MB");
+  if (sizeVar != NULL) {
+    if (sizeVar[0] != 0 && atoi(sizeVar) > 0) {
+      sizeMB = (size_t) atoi(sizeVar);
+    }
+  }
+
+  DeviceArena::HugePageMode hugePages = DeviceArena::HUGEPAGES_TRANSPARENT;
+  char *hugePagesVar = getenv("DRAM_ARENA_HUGEPAGES");
+  if (hugePagesVar != NULL) {
+    if (hugePagesVar[0] != 0 && atoi(hugePagesVar) >= 0 && atoi(hugePagesVar) <= 2) {
+      hugePages = (DeviceArena::HugePageMode) atoi(hugePagesVar);
+    }
+  }
+
+  struct stat st;
+  if ((sharedFd >= 0) && (fstat(sharedFd, &st) != 0)) {
+    sharedFd = -1;
+  }
+  DeviceArena *arena = new DeviceArena(sizeMB << 20, hugePages, sharedFd);
+
+  char *prefaultVar = getenv("DRAM_ARENA_PREFAULT");
+  if (prefaultVar != NULL) {
+    if (prefaultVar[0] != 0 && atoi(prefaultVar) > 0) {
+      EPRINTF("[DeviceArena] Prefaulting %lu MB\n", arena->size() >> 20);
+      arena->prefault();
+    }
+  }
+  EPRINTF("[DeviceArena] %lu MB %sdevice memory arena, %s\n", arena->size() >> 20, arena->isShared() ? "shared " : "", arena->modeName());
+  return arena;
+}
+
+#endif // __DEVICE_ARENA_H
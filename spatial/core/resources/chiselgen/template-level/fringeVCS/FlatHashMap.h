@@ -0,0 +1,175 @@
+#ifndef __FLAT_HASH_MAP_H
+#define __FLAT_HASH_MAP_H
+
+#include <cstdlib>
+#include <cstring>
+#include <stdio.h>
+#include <stdint.h>
+using namespace std;
+
+#include "commonDefs.h"
+
+/**
+ * Open-addressing hash map with linear probing, used for the per-burst
+ * (addr, tag) -> request lookups in the DRAM model.
+ * - Each slot stores the key's full 64-bit hash, so probing compares hashes
+ *   before keys and rehashing never recomputes them
+ * - Deletion shifts entries back instead of leaving tombstones, so probe
+ *   sequences stay short under constant insert/erase churn
+ * K must provide 'uint64_t hash() const', 'operator==' and a default constructor.
+ */
+template <class K, class V>
+class FlatHashMap {
+  struct Slot {
+    uint64_t hash;  // 0 == empty; stored hashes always have the top bit set
+    K key;
+    V value;
+  };
+
+  Slot *slots = NULL;
+  size_t capacity = 0;   // Always a power of 2
+  size_t mask = 0;
+  size_t numEntries = 0;
+
+  static uint64_t slotHash(const K &key) {
+    return key.hash() | (1ULL << 63);
+  }
+
+  void allocSlots(size_t cap) {
+    capacity = cap;
+    mask = cap - 1;
+    slots = new Slot[cap];
+    for (size_t i = 0; i < cap; i++) {
+      slots[i].hash = 0;
+    }
+  }
+
+  void insertHashed(uint64_t h, const K &key, V value) {
+    size_t i = h & mask;
+    while (slots[i].hash != 0) {
+      if (slots[i].hash == h && slots[i].key == key) {
+        slots[i].value = value;
+        return;
+      }
+      i = (i + 1) & mask;
+    }
+    slots[i].hash = h;
+    slots[i].key = key;
+    slots[i].value = value;
+    numEntries++;
+  }
+
+  void grow() {
+    Slot *old = slots;
+    size_t oldCapacity = capacity;
+    allocSlots(capacity * 2);
+    numEntries = 0;
+    for (size_t i = 0; i < oldCapacity; i++) {
+      if (old[i].hash != 0) {
+        insertHashed(old[i].hash, old[i].key, old[i].value);
+      }
+    }
+    delete[] old;
+  }
+
+  // Returns the slot index holding 'key', or capacity if absent
+  size_t lookup(const K &key) {
+    uint64_t h = slotHash(key);
+    size_t i = h & mask;
+    while (slots[i].hash != 0) {
+      if (slots[i].hash == h && slots[i].key == key) {
+        return i;
+      }
+      i = (i + 1) & mask;
+    }
+    return capacity;
+  }
+
+public:
+  FlatHashMap(size_t initialCapacity = 1024) {
+    size_t cap = 16;
+    while (cap < initialCapacity) cap <<= 1;
+    allocSlots(cap);
+  }
+
+  size_t size() {
+    return numEntries;
+  }
+
+  bool empty() {
+    return numEntries == 0;
+  }
+
+  // Insert or overwrite the value mapped to 'key'
+  void insert(const K &key, V value) {
+    // Keep load factor below 1/2 so that probe sequences stay within a cache line or two
+    if ((numEntries + 1) * 2 > capacity) grow();
+    insertHashed(slotHash(key), key, value);
+  }
+
+  // Returns a pointer to the value mapped to 'key', or NULL if absent
+  V* find(const K &key) {
+    size_t i = lookup(key);
+    return (i == capacity) ? NULL : &slots[i].value;
+  }
+
+  // Removes 'key', shifting later entries of its probe run back into the hole
+  // (Knuth's Algorithm R). Returns false if 'key' is absent.
+  bool erase(const K &key) {
+    size_t hole = lookup(key);
+    if (hole == capacity) return false;
+
+    size_t j = hole;
+    while (true) {
+      j = (j + 1) & mask;
+      if (slots[j].hash == 0) break;
+
+      // Entries whose home slot lies cyclically in (hole, j] must stay put
+      size_t home = slots[j].hash & mask;
+      bool stays = (hole <= j) ? (hole < home && home <= j) : (hole < home || home <= j);
+      if (!stays) {
+        slots[hole] = slots[j];
+        hole = j;
+      }
+    }
+    slots[hole].hash = 0;
+    numEntries--;
+    return true;
+  }
+
+  void clear() {
+    for (size_t i = 0; i < capacity; i++) {
+      slots[i].hash = 0;
+    }
+    numEntries = 0;
+  }
+
+  // Calls f(key, value) for every entry, in unspecified order
+  template <class F>
+  void forEach(F f) {
+    for (size_t i = 0; i < capacity; i++) {
+      if (slots[i].hash != 0) {
+        f(slots[i].key, slots[i].value);
+      }
+    }
+  }
+
+  ~FlatHashMap() {
+    delete[] slots;
+  }
+};
+
+/**
+ * 64-bit finalizer (from splitmix64) used to hash (addr, tag) keys.
+ */
+static inline uint64_t mixHash64(uint64_t a, uint64_t b) {
+  uint64_t h = a * 0x9E3779B97F4A7C15ULL ^ b;
+  h ^= h >> 30;
+  h *= 0xBF58476D1CE4E5B9ULL;
+  h ^= h >> 27;
+  h *= 0x94D049BB133111EBULL;
+  h ^= h >> 31;
+  return h;
+}
+
+#endif // __FLAT_HASH_MAP_H
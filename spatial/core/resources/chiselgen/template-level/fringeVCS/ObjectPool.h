@@ -0,0 +1,189 @@
+#ifndef __OBJECT_POOL_H
+#define __OBJECT_POOL_H
+
+#include <cstdlib>
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+using namespace std;
+
+#include "commonDefs.h"
+
+/**
+ * Fixed-size block allocator for the simulation models.
+ * Blocks are carved out of large slabs and recycled through an intrusive
+ * free list, so steady-state alloc/free never reaches malloc. Slabs are
+ * only returned to the OS when the allocator is destroyed.
+ */
+class SlabAllocator {
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  size_t blockSize;
+  size_t blocksPerSlab;
+  FreeBlock *freeList = NULL;
+  vector<uint8_t*> slabs;
+
+  void grow() {
+    uint8_t *slab = (uint8_t*) malloc(blockSize * blocksPerSlab);
+    ASSERT(slab != NULL, "[SlabAllocator %s] Unable to allocate slab of %lu bytes\n", name, blockSize * blocksPerSlab);
+    slabs.push_back(slab);
+
+    // Thread new blocks onto the free list in address order
+    for (size_t i = blocksPerSlab; i > 0; i--) {
+      FreeBlock *b = (FreeBlock*) (slab + (i-1) * blockSize);
+      b->next = freeList;
+      freeList = b;
+    }
+  }
+
+public:
+  const char *name;
+  uint64_t numLive = 0;     // Blocks currently handed out
+  uint64_t peakLive = 0;    // High-water mark of numLive
+  uint64_t numAllocs = 0;   // Total alloc() calls over the lifetime of the allocator
+
+  SlabAllocator(const char *name, size_t size, size_t blocksPerSlab = 4096) : blocksPerSlab(blocksPerSlab), name(name) {
+    // Every block must be able to hold a free list link and stay 8B aligned
+    blockSize = (size < sizeof(FreeBlock)) ? sizeof(FreeBlock) : size;
+    blockSize = (blockSize + 7) & ~((size_t)7);
+  }
+
+  size_t getBlockSize() {
+    return blockSize;
+  }
+
+  void *alloc() {
+    if (freeList == NULL) grow();
+    FreeBlock *b = freeList;
+    freeList = b->next;
+    numLive++;
+    numAllocs++;
+    if (numLive > peakLive) peakLive = numLive;
+    return (void*)b;
+  }
+
+  void free(void *ptr) {
+    if (ptr == NULL) return;
+    FreeBlock *b = (FreeBlock*) ptr;
+    b->next = freeList;
+    freeList = b;
+    numLive--;
+  }
+
+  size_t bytesReserved() {
+    return slabs.size() * blocksPerSlab * blockSize;
+  }
+
+  void printStats() {
+    EPRINTF("[SlabAllocator %-16s] live: %lu, peak: %lu, allocs: %lu, reserved: %lu KB\n", name, numLive, peakLive, numAllocs, bytesReserved() / 1024);
+  }
+
+  ~SlabAllocator() {
+    for (size_t i = 0; i < slabs.size(); i++) {
+      ::free(slabs[i]);
+    }
+    slabs.clear();
+  }
+};
+
+/**
+ * Allocator for variable-length arrays, backed by one SlabAllocator per
+ * power-of-two size class. Requests larger than the biggest class fall
+ * back to malloc, and are still tracked in the live count.
+ */
+class SizeClassAllocator {
+  static const int numClasses = 16;
+  static const size_t minClassBytes = 8;
+  SlabAllocator *classes[numClasses];
+
+  int sizeClass(size_t bytes) {
+    int c = 0;
+    size_t classBytes = minClassBytes;
+    while (classBytes < bytes && c < numClasses) {
+      classBytes <<= 1;
+      c++;
+    }
+    return c;
+  }
+
+public:
+  const char *name;
+  uint64_t numLargeLive = 0;
+
+  SizeClassAllocator(const char *name) : name(name) {
+    for (int i = 0; i < numClasses; i++) {
+      // Keep each slab at roughly 256 KB
+      size_t bytes = minClassBytes << i;
+      size_t blocksPerSlab = (bytes <= 64) ? 4096 : (256 * 1024) / bytes;
+      classes[i] = new SlabAllocator(name, bytes, blocksPerSlab);
+    }
+  }
+
+  void *alloc(size_t bytes) {
+    int c = sizeClass(bytes);
+    if (c >= numClasses) {
+      numLargeLive++;
+      return malloc(bytes);
+    }
+    return classes[c]->alloc();
+  }
+
+  void free(void *ptr, size_t bytes) {
+    if (ptr == NULL) return;
+    int c = sizeClass(bytes);
+    if (c >= numClasses) {
+      numLargeLive--;
+      ::free(ptr);
+    } else {
+      classes[c]->free(ptr);
+    }
+  }
+
+  uint64_t numLive() {
+    uint64_t live = numLargeLive;
+    for (int i = 0; i < numClasses; i++) {
+      live += classes[i]->numLive;
+    }
+    return live;
+  }
+
+  void printStats() {
+    uint64_t reserved = 0;
+    for (int i = 0; i < numClasses; i++) {
+      reserved += classes[i]->bytesReserved();
+    }
+    EPRINTF("[SlabAllocator %-16s] live: %lu, large live: %lu, reserved: %lu KB\n", name, numLive(), numLargeLive, reserved / 1024);
+  }
+
+  ~SizeClassAllocator() {
+    for (int i = 0; i < numClasses; i++) {
+      delete classes[i];
+    }
+  }
+};
+
+/**
+ * CRTP base that routes 'new T' / 'delete T' through a per-type SlabAllocator.
+ * Usage: class Foo : public PooledObject<Foo> { ... };
+ */
+template <class T>
+class PooledObject {
+public:
+  static SlabAllocator& pool() {
+    static SlabAllocator p(T::poolName, sizeof(T));
+    return p;
+  }
+
+  static void* operator new(size_t size) {
+    ASSERT(size == sizeof(T), "[PooledObject %s] Allocation of %lu bytes does not match object size %lu\n", T::poolName, size, sizeof(T));
+    return pool().alloc();
+  }
+
+  static void operator delete(void *ptr) {
+    pool().free(ptr);
+  }
+};
+
+#endif // __OBJECT_POOL_H
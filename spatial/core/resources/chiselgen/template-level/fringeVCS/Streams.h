@@ -11,96 +11,428 @@
 #include <fcntl.h>
 #include <signal.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <algorithm>
 using namespace std;
 
 #include "vc_hdrs.h"
 #include "svdpi_src.h"
 
+/**
+ * Input stream fed from a file, or live from another process
+ * Regular files are mmapped (or read in large chunks if they cannot be)
+ * instead of read one word per cycle. A word stays valid until the design
+ * takes it (valid & ready, reported through popInputStream), and words are
+ * offered at 'wordsPerCycle' on average: a fraction paces the stream below
+ * the port's one word per cycle.
+ * Live sources are FIFOs and UNIX domain sockets ("unix:<path>": the
+ * simulator listens there, and a producer such as tools/StreamReplayer
+ * connects). They are read without blocking, in batches, at most every
+ * 'livePollCycles' cycles while they have nothing to offer: the clock
+ * never waits for them, the stream is just not valid. A live stream does
+ * not end when its producer goes away; another one can connect.
+ * STREAM_IN_FORMAT selects the file format:
+ *   0 (raw)     32-bit data words; tags count up from 0, last is set on the
+ *               final word of a regular file
+ *   1 (tagged)  {data, tag, flags} 32-bit triples; bit 0 of flags is last
+ */
 class InputStream {
 public:
+  enum Format { FORMAT_RAW = 0, FORMAT_TAGGED = 1 };
+  static const size_t chunkSize = 1 << 16;
+  static const uint32_t livePollCycles = 16;
+
+  int id;             // Port index
+  string name;
   string filename;
   int fd;
+  Format format = FORMAT_RAW;
+  double wordsPerCycle;
+  double credit = 0;
+
+  // Bytes of the file not yet sent are [pos, end) of 'bytes'
+  uint8_t *bytes = NULL;
+  size_t pos = 0;
+  size_t end = 0;
+  bool mapped = false;
+  bool eof = false;
+  vector<uint8_t> buffer;
+
+  // Live sources: fd == -1 while no producer is connected to the socket
+  bool live = false;
+  int listenFd = -1;
+  uint32_t pollDelay = 0;
+
+  // Word currently offered to the design
+  bool presented = false;
+  uint32_t data = 0;
+  uint32_t tag = 0;
+  bool last = false;
+  uint32_t nextTag = 0;
+
+  uint64_t wordsAccepted = 0;
+  uint64_t stallCycles = 0;   // Cycles with a word offered but not taken
+  uint64_t starvedCycles = 0; // Cycles in which a word was due but there was no data
+
+  InputStream(int id, string name, string filename, double wordsPerCycle) : id(id), name(name), filename(filename), wordsPerCycle(std::min(wordsPerCycle, 1.0)) {
+    struct stat st;
+    if (filename.compare(0, 5, "unix:") == 0) {
+      listen(filename.substr(5));
+      fd = -1;
+      live = true;
+    } else {
+      fd = open(filename.c_str(), O_RDONLY | O_NONBLOCK);
+      ASSERT(fd != -1, "[InputStream] Error opening file '%s': %s\n", filename.c_str(), strerror(errno));
+      ASSERT(fstat(fd, &st) == 0, "[InputStream] Error reading file '%s': %s\n", filename.c_str(), strerror(errno));
+      live = !S_ISREG(st.st_mode);
+      if (!live) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+      }
+    }
+
+    char *formatVar = getenv("STREAM_IN_FORMAT");
+    if (formatVar != NULL) {
+      if (formatVar[0] != 0 && atoi(formatVar) == FORMAT_TAGGED) {
+        format = FORMAT_TAGGED;
+      }
+    }
+
+    if (!live && (st.st_size > 0)) {
+      void *ptr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (ptr != MAP_FAILED) {
+        madvise(ptr, st.st_size, MADV_SEQUENTIAL);
+        bytes = (uint8_t*) ptr;
+        end = st.st_size;
+        mapped = true;
+        eof = true;
+      }
+    }
+    if (!mapped) {
+      buffer.resize(2 * chunkSize);
+      bytes = &buffer[0];
+    }
+    EPRINTF("[InputStream] %d (%s) <- %s: %s, %s format, %.3f words/cycle\n", id, name.c_str(), filename.c_str(), mapped ? "mapped" : (live ? "live" : "buffered"), (format == FORMAT_TAGGED) ? "tagged" : "raw", wordsPerCycle);
+  }
+
+  // Listen on a UNIX domain socket for one producer at a time
+  void listen(string path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    ASSERT(path.size() < sizeof(addr.sun_path), "[InputStream] Socket path '%s' is too long\n", path.c_str());
+    strcpy(addr.sun_path, path.c_str());
+    unlink(path.c_str());
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT(listenFd != -1, "[InputStream] Error creating socket: %s\n", strerror(errno));
+    ASSERT(bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) == 0, "[InputStream] Error binding socket '%s': %s\n", path.c_str(), strerror(errno));
+    ASSERT(::listen(listenFd, 1) == 0, "[InputStream] Error listening on socket '%s': %s\n", path.c_str(), strerror(errno));
+    fcntl(listenFd, F_SETFL, fcntl(listenFd, F_GETFL) | O_NONBLOCK);
+  }
 
-  uint32_t next;
-  bool lastEncountered;
+  // One non-blocking read of whatever a live source has, unless it was empty very recently
+  void refillLive() {
+    if (pollDelay > 0) {
+      pollDelay--;
+      return;
+    }
+    pollDelay = livePollCycles;
+    if (fd == -1) {
+      fd = ::accept(listenFd, NULL, NULL);
+      if (fd == -1) return;
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+      EPRINTF("[InputStream] %d (%s): producer connected\n", id, name.c_str());
+    }
+    compact();
+    int bytesread = read(fd, bytes + end, buffer.size() - end);
+    if (bytesread > 0) {
+      end += bytesread;
+      pollDelay = 0;
+    } else if ((bytesread == 0) && (listenFd != -1)) {
+      EPRINTF("[InputStream] %d (%s): producer disconnected\n", id, name.c_str());
+      close(fd);
+      fd = -1;
+    } else {
+      ASSERT(bytesread == 0 || errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR, "[InputStream] Error reading '%s': %s\n", filename.c_str(), strerror(errno));
+    }
+  }
 
-  InputStream(string filename) : filename(filename) {
-    fd = open(filename.c_str(), O_RDONLY);
-    ASSERT(fd != -1, "[InputStream] Error opening file '%s': %s\n", filename.c_str(), strerror(errno));
-    next = 0;
-    lastEncountered = false;
+  // Move unsent bytes to the front of the buffer
+  void compact() {
+    if (pos > 0) {
+      memmove(bytes, bytes + pos, end - pos);
+      end -= pos;
+      pos = 0;
+    }
   }
 
-  void updateNext() {
+  // Make 'n' unsent bytes available, reading more of the file if needed; false at end of file, or if a live source has none yet
+  bool ensure(size_t n) {
+    if (live) {
+      if (end - pos < n) refillLive();
+      return end - pos >= n;
+    }
+    while ((end - pos < n) && !eof) {
+      compact();
+      int bytesread = read(fd, bytes + end, buffer.size() - end);
+      ASSERT(bytesread >= 0, "[InputStream] Error reading file '%s': %s\n", filename.c_str(), strerror(errno));
+      if (bytesread == 0) {
+        eof = true;
+      }
+      end += bytesread;
+    }
+    return end - pos >= n;
+  }
 
+  // Take the next word out of the file; false if there is none
+  bool fetch() {
+    size_t recordSize = (format == FORMAT_TAGGED) ? 3 * sizeof(uint32_t) : sizeof(uint32_t);
+    if (!ensure(recordSize)) return false;
+    uint32_t record[3];
+    memcpy(record, bytes + pos, recordSize);
+    pos += recordSize;
+    data = record[0];
+    if (format == FORMAT_TAGGED) {
+      tag = record[1];
+      last = (record[2] & 1) != 0;
+    } else {
+      tag = nextTag++;
+      last = !live && !ensure(recordSize);
+    }
+    return true;
   }
 
-  // Poll fd for new bytes
-  // - New data exists: Read and pass to writeStream
-  // - No new data: Return
+  // Called every cycle: offer a word to the design, if one is due
   void send() {
-    uint32_t data = 0;
-    static uint32_t tag = 0;
-    bool last = false;
-
-    int bytesread = read(fd, &data, sizeof(uint32_t));
-    ASSERT(bytesread >= 0, "[InputStream] Error reading file '%s': %s\n", filename.c_str(), strerror(errno));
-    if (bytesread < sizeof(uint32_t)) {
-      if (lastEncountered) { // If we have already seen last, don't send it again
-        last = false;
-      } else {
-        last = true;
-        lastEncountered = true;
+    credit = std::min(credit + wordsPerCycle, 1.0);
+    if (presented) {
+      stallCycles++;
+    } else if (credit >= 1.0) {
+      if (fetch()) {
+        presented = true;
+        credit -= 1.0;
+      } else if (live) {
+        starvedCycles++;
       }
-    } else {
-      last = false;
     }
+    if (presented) {
+      writeStream(id, data, tag, last);
+    }
+  }
 
-    writeStream(data, tag++, last);
+  // The design took the word offered in the last cycle
+  void accept() {
+    ASSERT(presented, "[InputStream] %s: design took a word that was not offered\n", filename.c_str());
+    presented = false;
+    wordsAccepted++;
   }
 
   ~InputStream() {
-    close(fd);
+    if (mapped) {
+      munmap(bytes, end);
+    }
+    if (fd != -1) close(fd);
+    if (listenFd != -1) close(listenFd);
   }
 };
 
 
+/**
+ * Output stream drained into a file or FIFO
+ * Words are collected in a buffer that is written out when it fills up,
+ * every 'flushInterval' cycles, and when the simulation finishes, instead
+ * of with one write() per word. The sink takes 'wordsPerCycle' words per
+ * cycle on average, and deasserts ready while it has no credit left.
+ * STREAM_OUT_FORMAT selects the file format:
+ *   0 (raw)     32-bit data words
+ *   1 (tagged)  {data, tag, flags} 32-bit triples; bit 0 of flags is last
+ */
 class OutputStream {
 public:
+  static const size_t bufferWords = 1 << 16;
+  static const uint64_t flushInterval = 1000000;
+
+  int id;             // Port index
+  string name;
   string filename;
   int fd;
+  bool tagged = false;
+  double wordsPerCycle;
+  double credit = 0;
+
+  vector<uint32_t> buffer;
+  uint64_t cyclesSinceFlush = 0;
+  uint64_t wordsReceived = 0;
+  uint64_t notReadyCycles = 0;
 
-  OutputStream(string filename) : filename(filename) {
-    fd = open(filename.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+  OutputStream(int id, string name, string filename, double wordsPerCycle) : id(id), name(name), filename(filename), wordsPerCycle(std::min(wordsPerCycle, 1.0)) {
+    fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
     ASSERT(fd != -1, "[OutputStream] Error opening file '%s': %s\n", filename.c_str(), strerror(errno));
+
+    char *formatVar = getenv("STREAM_OUT_FORMAT");
+    if (formatVar != NULL) {
+      if (formatVar[0] != 0 && atoi(formatVar) == 1) {
+        tagged = true;
+      }
+    }
+    buffer.reserve(bufferWords);
+    EPRINTF("[OutputStream] %d (%s) -> %s: %s format, %.3f words/cycle\n", id, name.c_str(), filename.c_str(), tagged ? "tagged" : "raw", this->wordsPerCycle);
+  }
+
+  // Called every cycle, before the design's output is sampled
+  void cycle() {
+    credit = std::min(credit + wordsPerCycle, 1.0);
+    if (!ready()) notReadyCycles++;
+    if (++cyclesSinceFlush >= flushInterval) flush();
   }
 
-  // Callback function called from SV -> sim.cpp
-  // Just write data into a file
-  // [TODO] In current scheme, output stream is always ready. Model backpressure more accurately.
+  bool ready() {
+    return credit >= 1.0;
+  }
+
+  // Callback function called from SV -> sim.cpp when the design hands over a word (valid & ready)
   void recv(uint32_t udata, uint32_t utag, bool blast) {
-    // Currently print read data out to console in addition to file
-    //EPRINTF("[readOutputStream] data = %08x, tag = %08x, last = %x\n", udata, utag, blast);
+    credit -= 1.0;
+    wordsReceived++;
+    buffer.push_back(udata);
+    if (tagged) {
+      buffer.push_back(utag);
+      buffer.push_back(blast ? 1 : 0);
+    }
+    if (buffer.size() + 3 > bufferWords) flush();
+  }
 
-    int bytes = write(fd, &udata, sizeof(uint32_t));   // Ignore tag for now
-    ASSERT(bytes >= 0, "[OutputStream] Error writing to file '%s': %s\n", filename.c_str(), strerror(errno));
+  void flush() {
+    const uint8_t *bytes = (const uint8_t*) buffer.data();
+    size_t size = buffer.size() * sizeof(uint32_t);
+    while (size > 0) {
+      ssize_t written = write(fd, bytes, size);
+      ASSERT(written >= 0 || errno == EINTR, "[OutputStream] Error writing to file '%s': %s\n", filename.c_str(), strerror(errno));
+      if (written < 0) continue;
+      bytes += written;
+      size -= written;
+    }
+    buffer.clear();
+    cyclesSinceFlush = 0;
   }
 
   ~OutputStream() {
+    flush();
     close(fd);
   }
 };
 
-// Input stream
-InputStream *inStream = NULL;
+// Streams, by port index
+vector<InputStream*> inStreams;
+vector<OutputStream*> outStreams;
 
-// Output stream
-OutputStream *outStream = NULL;
+/**
+ * Stream files from the environment, one stream per port:
+ *   STREAM_IN_FILES / STREAM_OUT_FILES   Comma-separated [name=]path[@wordsPerCycle]
+ *                                        (default in.txt / out.txt); input paths
+ *                                        can also be unix:<socket path>
+ *   STREAM_IN_WORDS_PER_CYCLE /          Rate of streams that do not give one (default 1)
+ *   STREAM_OUT_WORDS_PER_CYCLE
+ * Paths can be regular files or FIFOs.
+ */
+struct StreamConfig {
+  string name;
+  string path;
+  double wordsPerCycle;
+};
+
+vector<StreamConfig> parseStreamList(const char *listVar, const char *rateVar, const char *defaultPath) {
+  double defaultRate = 1;
+  char *rate = getenv(rateVar);
+  if (rate != NULL) {
+    if (rate[0] != 0 && atof(rate) > 0) {
+      defaultRate = atof(rate);
+    }
+  }
+
+  string list = defaultPath;
+  char *listValue = getenv(listVar);
+  if (listValue != NULL && listValue[0] != 0) {
+    list = listValue;
+  }
+
+  vector<StreamConfig> streams;
+  size_t start = 0;
+  while (start <= list.size()) {
+    size_t comma = list.find(',', start);
+    if (comma == string::npos) comma = list.size();
+    string entry = list.substr(start, comma - start);
+    start = comma + 1;
+    if (entry.empty()) continue;
+
+    StreamConfig c;
+    c.wordsPerCycle = defaultRate;
+    size_t at = entry.rfind('@');
+    if (at != string::npos) {
+      c.wordsPerCycle = atof(entry.substr(at + 1).c_str());
+      ASSERT(c.wordsPerCycle > 0, "[Streams] %s: bad rate in '%s'\n", listVar, entry.c_str());
+      entry = entry.substr(0, at);
+    }
+    size_t eq = entry.find('=');
+    c.name = (eq == string::npos) ? entry : entry.substr(0, eq);
+    c.path = (eq == string::npos) ? entry : entry.substr(eq + 1);
+    streams.push_back(c);
+  }
+  return streams;
+}
 
 void initStreams() {
   // Initialize simulation streams
-  inStream = new InputStream("in.txt");
-  outStream = new OutputStream("out.txt");
+  vector<StreamConfig> ins = parseStreamList("STREAM_IN_FILES", "STREAM_IN_WORDS_PER_CYCLE", "in.txt");
+  for (size_t i = 0; i < ins.size(); i++) {
+    inStreams.push_back(new InputStream(i, ins[i].name, ins[i].path, ins[i].wordsPerCycle));
+  }
+  vector<StreamConfig> outs = parseStreamList("STREAM_OUT_FILES", "STREAM_OUT_WORDS_PER_CYCLE", "out.txt");
+  for (size_t i = 0; i < outs.size(); i++) {
+    outStreams.push_back(new OutputStream(i, outs[i].name, outs[i].path, outs[i].wordsPerCycle));
+  }
 }
 
+extern "C" {
+  // Callback function from SV when output stream 'stream' has valid data and is ready
+  void readOutputStream(int stream, int data, int tag, int last) {
+    // view addr as uint64_t without doing sign extension
+    uint32_t udata = *(uint32_t*)&data;
+    uint32_t utag = *(uint32_t*)&tag;
+    bool blast = last > 0;
+
+    outStreams[stream]->recv(udata, utag, blast);
+  }
+
+  // Ready signal of output stream 'stream' for this cycle
+  int outputStreamReady(int stream) {
+    return outStreams[stream]->ready() ? 1 : 0;
+  }
+
+  // Callback function from SV when the design takes the word on input stream 'stream'
+  void popInputStream(int stream) {
+    inStreams[stream]->accept();
+  }
+}
+
+// Called every cycle
+void cycleStreams() {
+  for (size_t i = 0; i < inStreams.size(); i++) {
+    inStreams[i]->send();
+  }
+  for (size_t i = 0; i < outStreams.size(); i++) {
+    outStreams[i]->cycle();
+  }
+}
+
+void flushStreams() {
+  for (size_t i = 0; i < outStreams.size(); i++) {
+    outStreams[i]->flush();
+    EPRINTF("[OutputStream] %d (%s): %lu words, not ready for %lu cycles\n", (int)i, outStreams[i]->name.c_str(), outStreams[i]->wordsReceived, outStreams[i]->notReadyCycles);
+  }
+  for (size_t i = 0; i < inStreams.size(); i++) {
+    EPRINTF("[InputStream] %d (%s): %lu words, stalled for %lu cycles, starved for %lu cycles\n", (int)i, inStreams[i]->name.c_str(), inStreams[i]->wordsAccepted, inStreams[i]->stallCycles, inStreams[i]->starvedCycles);
+  }
+}
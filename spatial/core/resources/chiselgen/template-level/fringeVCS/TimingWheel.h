@@ -0,0 +1,74 @@
+#ifndef __TIMING_WHEEL_H
+#define __TIMING_WHEEL_H
+
+#include <stdint.h>
+#include <vector>
+#include <map>
+using namespace std;
+
+/**
+ * Timing wheel (calendar queue) of events keyed by simulation cycle.
+ * Events due within 'numSlots' cycles live in the wheel slot for their
+ * cycle, so scheduling and firing are O(1); events further out wait in an
+ * ordered overflow map and migrate into the wheel as time catches up.
+ * Events due in the same cycle fire in the order they were scheduled.
+ */
+template <class T>
+class TimingWheel {
+  vector<vector<T> > slots;
+  uint64_t mask;
+  uint64_t now = 0;             // Next cycle to be fired; all earlier cycles are done
+  multimap<uint64_t, T> overflow;
+  uint64_t numPending = 0;
+
+  void migrateOverflow() {
+    while (!overflow.empty() && (overflow.begin()->first < now + slots.size())) {
+      slots[overflow.begin()->first & mask].push_back(overflow.begin()->second);
+      overflow.erase(overflow.begin());
+    }
+  }
+
+public:
+  TimingWheel(size_t numSlots = 1024) {
+    size_t n = 1;
+    while (n < numSlots) n <<= 1;
+    slots.resize(n);
+    mask = n - 1;
+  }
+
+  // Schedule 'item' to fire at 'cycle'; cycles already fired are bumped to the next advance()
+  void schedule(T item, uint64_t cycle) {
+    if (cycle < now) cycle = now;
+    if (cycle - now < slots.size()) {
+      slots[cycle & mask].push_back(item);
+    } else {
+      overflow.insert(make_pair(cycle, item));
+    }
+    numPending++;
+  }
+
+  // Fire f(item) for every event due at or before 'cycle'
+  template <class F>
+  void advance(uint64_t cycle, F f) {
+    while (now <= cycle) {
+      if (numPending == 0) {
+        now = cycle + 1;
+        break;
+      }
+      migrateOverflow();
+      vector<T> &slot = slots[now & mask];
+      for (size_t i = 0; i < slot.size(); i++) {
+        f(slot[i]);
+      }
+      numPending -= slot.size();
+      slot.clear();
+      now++;
+    }
+  }
+
+  uint64_t size() {
+    return numPending;
+  }
+};
+
+#endif // __TIMING_WHEEL_H
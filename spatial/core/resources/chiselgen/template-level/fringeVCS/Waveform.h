@@ -0,0 +1,187 @@
+#ifndef __WAVEFORM_H
+#define __WAVEFORM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Included by sim.cpp, after numCycles and the DPI functions are declared
+
+/**
+ * Cycle windows and triggers for waveform dumps
+ * VPD_ON / VCD_ON select the formats. By default the whole run is dumped;
+ * these narrow it down:
+ *   WAVE_START=<cycle>          Do not dump before this cycle
+ *   WAVE_CYCLES=<n>             Stop after n cycles of dumping (0 == until the end)
+ *   WAVE_TRIGGER_REG=<reg>      Wait, after WAVE_START, until this register reads
+ *   WAVE_TRIGGER_VALUE=<value>  this value (default: any non-zero value)
+ *   WAVE_RING_CYCLES=<k>        VPD only: keep just the last k to 2k cycles before
+ *                               the simulation ends (finishes, fails or is killed),
+ *                               in Top.ring0.vpd and Top.ring1.vpd, alternating
+ *                               every k cycles
+ * The trigger register is checked whenever the simulator sees its value:
+ * host reads and writes of it, and, while the design runs by itself
+ * (RUN_UNTIL_DONE), by polling it every waveTriggerPollCycles cycles.
+ * Dumps are flushed every waveFlushInterval cycles and when they stop,
+ * instead of every cycle.
+ */
+const uint64_t waveTriggerPollCycles = 64;
+const uint64_t waveFlushInterval = 10000;
+
+struct {
+  bool vpd = false;
+  bool vcd = false;
+  bool dumping = false;
+  bool done = false;          // The window is over, nothing more to dump
+  uint64_t start = 0;
+  uint64_t cycles = 0;
+  uint64_t ringCycles = 0;
+  bool armed = false;         // Waiting for the trigger
+  uint32_t triggerReg = 0;
+  bool anyTriggerValue = true;
+  uint64_t triggerValue = 0;
+
+  uint64_t windowStart = 0;   // Cycle dumping started at
+  uint64_t dumpStart = 0;     // Cycle the current ring file started at
+  uint64_t lastFlush = 0;
+  int ringFile = 0;
+  uint64_t ringRotations = 0;
+} waves;
+
+uint64_t waveEnv(const char *name, uint64_t defaultValue) {
+  char *value = getenv(name);
+  if (value == NULL || value[0] == 0) return defaultValue;
+  return strtoull(value, NULL, 0);
+}
+
+bool waveEnabled(const char *name) {
+  char *value = getenv(name);
+  return (value != NULL) && (value[0] != 0) && (atoi(value) > 0);
+}
+
+void ringFileName(int file, char *name, size_t size) {
+  snprintf(name, size, "Top.ring%d.vpd", file);
+}
+
+void startWaves() {
+  if (waves.vpd) {
+    if (waves.ringCycles > 0) {
+      char name[32];
+      ringFileName(waves.ringFile, name, sizeof(name));
+      rotateVPD(name);
+    }
+    startVPD();
+  }
+  if (waves.vcd) startVCD();
+  waves.dumping = true;
+  waves.windowStart = numCycles;
+  waves.dumpStart = numCycles;
+  waves.lastFlush = numCycles;
+  EPRINTF("[SIM] Waveforms on at cycle %lu\n", numCycles);
+}
+
+void stopWaves() {
+  if (waves.vpd) stopVPD();
+  if (waves.vcd) stopVCD();
+  waves.dumping = false;
+  waves.done = true;
+  EPRINTF("[SIM] Waveforms off at cycle %lu\n", numCycles);
+}
+
+void initWaves() {
+  waves.vpd = waveEnabled("VPD_ON");
+  waves.vcd = waveEnabled("VCD_ON");
+  EPRINTF("[SIM] VPD Waveforms %s\n", waves.vpd ? "ENABLED" : "DISABLED");
+  EPRINTF("[SIM] VCD Waveforms %s\n", waves.vcd ? "ENABLED" : "DISABLED");
+  if (!waves.vpd && !waves.vcd) {
+    waves.done = true;
+    return;
+  }
+
+  waves.start = waveEnv("WAVE_START", 0);
+  waves.cycles = waveEnv("WAVE_CYCLES", 0);
+  waves.ringCycles = waveEnv("WAVE_RING_CYCLES", 0);
+  char *triggerReg = getenv("WAVE_TRIGGER_REG");
+  if (triggerReg != NULL && triggerReg[0] != 0) {
+    waves.armed = true;
+    waves.triggerReg = (uint32_t)strtoul(triggerReg, NULL, 0);
+    char *triggerValue = getenv("WAVE_TRIGGER_VALUE");
+    if (triggerValue != NULL && triggerValue[0] != 0) {
+      waves.anyTriggerValue = false;
+      waves.triggerValue = strtoull(triggerValue, NULL, 0);
+    }
+  }
+  if ((waves.ringCycles > 0) && !waves.vpd) {
+    EPRINTF("[SIM] WAVE_RING_CYCLES needs VPD_ON, dumping the whole window to VCD\n");
+    waves.ringCycles = 0;
+  }
+
+  if (waves.start > 0 || waves.cycles > 0 || waves.armed || waves.ringCycles > 0) {
+    EPRINTF("[SIM] Waveform window: from cycle %lu", waves.start);
+    if (waves.armed) {
+      if (waves.anyTriggerValue) {
+        EPRINTF(", once register %u is non-zero", waves.triggerReg);
+      } else {
+        EPRINTF(", once register %u is %lu", waves.triggerReg, waves.triggerValue);
+      }
+    }
+    if (waves.cycles > 0) EPRINTF(", for %lu cycles", waves.cycles);
+    if (waves.ringCycles > 0) EPRINTF(", last %lu-%lu cycles only", waves.ringCycles, 2 * waves.ringCycles);
+    EPRINTF("\n");
+  }
+
+  // Without a window, dump from the start as before
+  if (waves.start == 0 && !waves.armed) {
+    startWaves();
+  }
+}
+
+bool waveTriggerArmed() {
+  return waves.armed && !waves.done && (numCycles >= waves.start);
+}
+
+// The simulator saw register 'reg' hold 'value'
+void checkWaveTrigger(uint32_t reg, uint64_t value) {
+  if (!waveTriggerArmed() || (reg != waves.triggerReg)) return;
+  if (waves.anyTriggerValue ? (value != 0) : (value == waves.triggerValue)) {
+    EPRINTF("[SIM] Waveform trigger: register %u = %lu at cycle %lu\n", reg, value, numCycles);
+    waves.armed = false;
+  }
+}
+
+// Called every cycle
+void cycleWaves() {
+  if (waves.done) return;
+  if (!waves.dumping) {
+    if (!waves.armed && (numCycles >= waves.start)) startWaves();
+    return;
+  }
+
+  if ((waves.cycles > 0) && (numCycles - waves.windowStart >= waves.cycles)) {
+    stopWaves();
+  } else if ((waves.ringCycles > 0) && (numCycles - waves.dumpStart >= waves.ringCycles)) {
+    waves.ringFile ^= 1;
+    waves.ringRotations++;
+    char name[32];
+    ringFileName(waves.ringFile, name, sizeof(name));
+    rotateVPD(name);
+    waves.dumpStart = numCycles;
+    waves.lastFlush = numCycles;
+  } else if (numCycles - waves.lastFlush >= waveFlushInterval) {
+    flushWaves();
+    waves.lastFlush = numCycles;
+  }
+}
+
+void finishWaves() {
+  if (waves.dumping && (waves.ringCycles > 0)) {
+    char name[32], older[32];
+    ringFileName(waves.ringFile, name, sizeof(name));
+    ringFileName(waves.ringFile ^ 1, older, sizeof(older));
+    EPRINTF("[SIM] Last %lu cycles of waveforms in %s", numCycles - waves.dumpStart, name);
+    if (waves.ringRotations > 0) EPRINTF(", the %lu before in %s", waves.ringCycles, older);
+    EPRINTF("\n");
+  }
+}
+
+#endif // __WAVEFORM_H
@@ -0,0 +1,148 @@
+/**
+ * Microbenchmark for the (addr, tag) -> DRAMRequest lookup in DRAM.h
+ * Models the steady state of the DRAM simulation: 'inFlight' bursts are
+ * outstanding, and every new burst pays one insert (sendDRAMRequest) and
+ * one find + erase (txComplete) of an older burst. Completion order is
+ * shuffled within a window to mimic DRAMSim2 reordering across banks.
+ *
+ * Build & run: make bench && ./bench/AddrTagMapBench [inFlight] [numBursts]
+ */
+#include <chrono>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "FlatHashMap.h"
+
+typedef union DRAMTag {
+  struct {
+    unsigned int uid : 32;
+    unsigned int streamId : 32;
+  };
+  uint64_t tag;
+} DRAMTag;
+
+// Same layout and ordering as AddrTag in DRAM.h
+struct AddrTag {
+  uint64_t addr;
+  DRAMTag tag;
+
+  AddrTag() {
+    addr = 0;
+    tag.tag = 0;
+  }
+
+  AddrTag(uint64_t a, DRAMTag t) {
+    addr = a;
+    tag = t;
+  }
+
+  uint64_t hash() const {
+    return mixHash64(addr, tag.tag);
+  }
+
+  bool operator==(const AddrTag &o) const {
+      return addr == o.addr && tag.tag == o.tag.tag;
+  }
+
+  bool operator<(const AddrTag &o) const {
+      return addr < o.addr || (addr == o.addr && tag.tag < o.tag.tag);
+  }
+};
+
+struct DRAMRequest {
+  uint64_t id;
+  bool completed;
+};
+
+std::vector<AddrTag> makeKeys(size_t n) {
+  std::vector<AddrTag> keys(n);
+  uint64_t base = 0x7f0000000000ULL;
+  for (size_t i = 0; i < n; i++) {
+    DRAMTag t;
+    t.uid = (uint32_t)(i / 16);        // One command per 16 bursts
+    t.streamId = (uint32_t)(i % 4);    // 4 streams
+    keys[i] = AddrTag(base + i * 64, t);
+  }
+  return keys;
+}
+
+// Completion order: issue order shuffled within windows of 'window' bursts
+std::vector<size_t> makeCompletionOrder(size_t n, size_t window) {
+  std::vector<size_t> order(n);
+  for (size_t i = 0; i < n; i++) order[i] = i;
+  std::mt19937_64 rng(42);
+  for (size_t i = 0; i < n; i += window) {
+    std::shuffle(order.begin() + i, order.begin() + std::min(n, i + window), rng);
+  }
+  return order;
+}
+
+template <class Insert, class FindErase>
+double run(const std::vector<AddrTag> &keys, const std::vector<size_t> &order, size_t inFlight, size_t window, std::vector<DRAMRequest> &reqs, Insert insert, FindErase findErase) {
+  size_t n = keys.size();
+  size_t lagBatches = inFlight / window;
+  auto start = std::chrono::steady_clock::now();
+
+  // Issue one window of bursts at a time, and complete the window issued 'inFlight' bursts earlier
+  size_t numBatches = n / window;
+  for (size_t b = 0; b < numBatches + lagBatches; b++) {
+    if (b < numBatches) {
+      for (size_t i = b * window; i < (b + 1) * window; i++) {
+        insert(keys[i], &reqs[i]);
+      }
+    }
+    if (b >= lagBatches) {
+      size_t cb = b - lagBatches;
+      for (size_t i = cb * window; i < (cb + 1) * window; i++) {
+        findErase(keys[order[i]]);
+      }
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / (numBatches * window);
+}
+
+int main(int argc, char **argv) {
+  size_t inFlight = argc > 1 ? atol(argv[1]) : 16384;
+  size_t numBursts = argc > 2 ? atol(argv[2]) : 4000000;
+  size_t window = 256;
+
+  if (inFlight < window) inFlight = window;
+  numBursts = (numBursts / window) * window;
+
+  std::vector<AddrTag> keys = makeKeys(numBursts);
+  std::vector<size_t> order = makeCompletionOrder(numBursts, window);
+  std::vector<DRAMRequest> reqs(numBursts);
+  uint64_t misses = 0;
+
+  std::map<AddrTag, DRAMRequest*> treeMap;
+  double treeNs = run(keys, order, inFlight, window, reqs,
+    [&](const AddrTag &k, DRAMRequest *r) { treeMap[k] = r; },
+    [&](const AddrTag &k) {
+      std::map<AddrTag, DRAMRequest*>::iterator it = treeMap.find(k);
+      if (it == treeMap.end()) { misses++; return; }
+      it->second->completed = true;
+      treeMap.erase(it);
+    });
+
+  FlatHashMap<AddrTag, DRAMRequest*> flatMap(16384);
+  double flatNs = run(keys, order, inFlight, window, reqs,
+    [&](const AddrTag &k, DRAMRequest *r) { flatMap.insert(k, r); },
+    [&](const AddrTag &k) {
+      DRAMRequest **it = flatMap.find(k);
+      if (it == NULL) { misses++; return; }
+      (*it)->completed = true;
+      flatMap.erase(k);
+    });
+
+  printf("bursts: %lu, in flight: %lu, misses: %lu\n", numBursts, inFlight, misses);
+  printf("std::map<AddrTag>      : %6.1f ns/burst (insert + find + erase)\n", treeNs);
+  printf("FlatHashMap<AddrTag>   : %6.1f ns/burst (insert + find + erase)\n", flatNs);
+  printf("speedup                : %6.2fx\n", treeNs / flatNs);
+  return (misses == 0) ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+/**
+ * Microbenchmark for the host <-> simulator channel (cppgen/fringeVCS/channel.h)
+ * Compares the pipe transport with the shared-memory ring transport, with a
+ * forked child standing in for the simulator:
+ * - latency: READ_REG-style round trips (one simCmd each way)
+ * - throughput: WRITE_REG-style one-way commands, then one round trip
+ * - bulk: sendFixedBytes of a large buffer (pipe-based MEMCPY_H2D)
+ *
+ * Build & run: make bench && ./bench/ChannelBench [roundTrips] [bulkMB]
+ */
+#include <chrono>
+#include <vector>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+
+#include "simDefs.h"
+#include "channel.h"
+
+// Echo server: answers READ_REG and MEMCPY_H2D, swallows WRITE_REG
+void serve(Channel *cmdChannel, Channel *respChannel, uint8_t *bulk) {
+  while (true) {
+    simCmd *cmd = (simCmd*) cmdChannel->recv();
+    simCmd resp;
+    resp.id = cmd->id;
+    resp.cmd = cmd->cmd;
+    resp.size = 0;
+    switch (cmd->cmd) {
+      case WRITE_REG:
+        break;
+      case MEMCPY_H2D:
+        cmdChannel->recvFixedBytes(bulk, ((uint64_t*)cmd->data)[1]);
+        respChannel->send(&resp);
+        break;
+      case FIN:
+        respChannel->send(&resp);
+        exit(0);
+      default:
+        respChannel->send(&resp);
+        break;
+    }
+  }
+}
+
+double seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void roundTrip(Channel *cmdChannel, Channel *respChannel, simCmd *cmd) {
+  cmdChannel->send(cmd);
+  simCmd *resp = (simCmd*) respChannel->recv();
+  if (resp->id != cmd->id) {
+    EPRINTF("Response %d does not match command %d\n", resp->id, cmd->id);
+    exit(-1);
+  }
+}
+
+void run(const char *name, Channel *cmdChannel, Channel *respChannel, pid_t child, int numRoundTrips, size_t bulkBytes, uint8_t *bulk) {
+  cmdChannel->setPeer(child);
+  respChannel->setPeer(child);
+  simCmd cmd;
+  memset(&cmd, 0, sizeof(cmd));
+
+  cmd.cmd = READ_REG;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int i = 0; i < numRoundTrips; i++) {
+    cmd.id = i;
+    roundTrip(cmdChannel, respChannel, &cmd);
+  }
+  double latency = seconds(start) / numRoundTrips;
+
+  start = std::chrono::steady_clock::now();
+  cmd.cmd = WRITE_REG;
+  for (int i = 0; i < numRoundTrips; i++) {
+    cmdChannel->send(&cmd);
+  }
+  cmd.cmd = READ_REG;
+  roundTrip(cmdChannel, respChannel, &cmd);
+  double rate = numRoundTrips / seconds(start);
+
+  start = std::chrono::steady_clock::now();
+  cmd.cmd = MEMCPY_H2D;
+  ((uint64_t*)cmd.data)[1] = bulkBytes;
+  cmdChannel->send(&cmd);
+  cmdChannel->sendFixedBytes(bulk, bulkBytes);
+  respChannel->recv();
+  double bandwidth = bulkBytes / seconds(start) / (1 << 20);
+
+  cmd.cmd = FIN;
+  roundTrip(cmdChannel, respChannel, &cmd);
+  waitpid(child, NULL, 0);
+
+  printf("%-5s: %8.2f us/round trip, %10.0f commands/s, %8.1f MB/s bulk\n", name, latency * 1e6, rate, bandwidth);
+}
+
+int main(int argc, char **argv) {
+  int numRoundTrips = (argc > 1) ? atoi(argv[1]) : 100000;
+  size_t bulkBytes = ((argc > 2) ? atol(argv[2]) : 256) << 20;
+  uint8_t *bulk = (uint8_t*) malloc(bulkBytes);
+  memset(bulk, 1, bulkBytes);
+  signal(SIGPIPE, SIG_IGN);
+
+  printf("%d round trips of %lu-byte commands, %lu MB bulk transfer, %ld CPUs\n", numRoundTrips, sizeof(simCmd), bulkBytes >> 20, sysconf(_SC_NPROCESSORS_ONLN));
+
+  Channel *cmdPipe = new Channel(sizeof(simCmd));
+  Channel *respPipe = new Channel(sizeof(simCmd));
+  fflush(stdout);
+  pid_t child = fork();
+  if (child == 0) serve(cmdPipe, respPipe, bulk);
+  run("pipe", cmdPipe, respPipe, child, numRoundTrips, bulkBytes, bulk);
+
+  ShmRing *cmdRing, *respRing;
+  int fd = createShmRings(1 << 20, &cmdRing, &respRing);
+  if (fd < 0) {
+    printf("ring : unavailable (%s)\n", strerror(errno));
+    return 0;
+  }
+  Channel *cmdShm = new Channel(cmdRing, sizeof(simCmd));
+  Channel *respShm = new Channel(respRing, sizeof(simCmd));
+  fflush(stdout);
+  child = fork();
+  if (child == 0) serve(cmdShm, respShm, bulk);
+  run("ring", cmdShm, respShm, child, numRoundTrips, bulkBytes, bulk);
+  return 0;
+}
@@ -25,6 +25,8 @@ using namespace std;
 
 #include <DRAM.h>
 #include <Streams.h>
+#include <Checkpoint.h>
+#include <Waveform.h>
 
 extern char **environ;
 
@@ -59,18 +61,120 @@ set<uint64_t> allocatedPages;
 queue<pendingOp*> pendingOps;
 uint64_t numCycles = 0;
 
-extern "C" {
-  // Callback function from SV when there is valid data
-  // Currently output stream is always ready, so there is no feedback going from C++ -> SV
-  void readOutputStream(int data, int tag, int last) {
-    // view addr as uint64_t without doing sign extension
-    uint32_t udata = *(uint32_t*)&data;
-    uint32_t utag = *(uint32_t*)&tag;
-    bool blast = last > 0;
-
-    // Currently just print read data out to console
-    outStream->recv(udata, utag, blast);
+// State of an outstanding RUN_UNTIL_DONE command
+struct {
+  bool active = false;
+  int id;
+  uint64_t startCycles;
+  uint64_t maxCycles;
+  uint64_t nextPrint;
+  uint32_t reg;
+  uint32_t pollPhase = 0;   // Waveform trigger poll in progress, see runUntilDoneCycle
+} runUntilDone;
+const uint64_t runProgressInterval = 10000;
+
+// State of an outstanding READ_REGS / WRITE_REGS command: one register is issued per cycle
+struct {
+  bool active = false;
+  int id;
+  SIM_CMD cmd;
+  simRegBatch batch;
+  uint32_t cycle;     // Cycles since the batch started
+} regBatch;
+
+// Value of the register last selected with readRegRaddr, two cycles after selecting it
+uint64_t readRegRdata() {
+  SV_BIT_PACKED_ARRAY(32, rdataHi);
+  SV_BIT_PACKED_ARRAY(32, rdataLo);
+  readRegRdataHi32((svBitVec32*)&rdataHi);
+  readRegRdataLo32((svBitVec32*)&rdataLo);
+  return ((uint64_t)(uint32_t)*rdataHi << 32) | (uint32_t)*rdataLo;
+}
+
+/**
+ * One cycle of RUN_UNTIL_DONE: advance DRAMSim2, report progress, and reply
+ * once the polled register goes non-zero or the cycle budget is used up
+ */
+void runUntilDoneCycle() {
+  if (!useIdealDRAM) {
+    updateDRAM();
+  }
+
+  uint64_t elapsed = numCycles - runUntilDone.startCycles;
+  if (elapsed >= runUntilDone.nextPrint) {
+    EPRINTF("[SIM] \t%lu cycles elapsed\n", runUntilDone.nextPrint);
+    runUntilDone.nextPrint += runProgressInterval;
+  }
+
+  // The register's value is valid two cycles after it was selected. An
+  // armed waveform trigger borrows the read port every waveTriggerPollCycles:
+  // its register is selected for two cycles, then the polled one again, and
+  // the polled register is not read in between
+  uint32_t phase = runUntilDone.pollPhase;
+  uint64_t status = ((elapsed >= 2) && (phase == 0)) ? readRegRdata() : 0;
+  if ((elapsed >= 2) && (phase == 0)) {
+    checkWaveTrigger(runUntilDone.reg, status);
+  }
+  if (phase == 0) {
+    if (waveTriggerArmed() && (elapsed >= 2) && (elapsed % waveTriggerPollCycles == 0)) {
+      readRegRaddr(waves.triggerReg);
+      runUntilDone.pollPhase = 1;
+    }
+  } else if (phase == 2) {
+    checkWaveTrigger(waves.triggerReg, readRegRdata());
+    readRegRaddr(runUntilDone.reg);
+    runUntilDone.pollPhase = 3;
+  } else {
+    runUntilDone.pollPhase = (phase + 1) % 4;
+  }
+
+  if ((status != 0) || (elapsed >= runUntilDone.maxCycles)) {
+    simCmd resp;
+    resp.id = runUntilDone.id;
+    resp.cmd = RUN_UNTIL_DONE;
+    uint64_t *data = (uint64_t*)resp.data;
+    data[0] = status;
+    data[1] = elapsed;
+    resp.size = 2 * sizeof(uint64_t);
+    respChannel->send(&resp);
+    runUntilDone.active = false;
+  }
+}
+
+/**
+ * One cycle of a register batch. Writes go out one per cycle. Each read
+ * address is held for two cycles, as for READ_REG, because the design
+ * registers rdata; a value is sampled in the same cycle that the next
+ * address is selected. The batch is answered with a single response.
+ */
+void regBatchCycle() {
+  simRegBatch &b = regBatch.batch;
+  uint32_t c = regBatch.cycle++;
+  if (regBatch.cmd == WRITE_REGS) {
+    writeReg(b.regs[c], b.data[c]);
+    checkWaveTrigger(b.regs[c], b.data[c]);
+    if (c + 1 == b.num) regBatch.active = false;
+    return;
+  }
+
+  if (c % 2 == 1) return;
+  uint32_t i = c / 2;
+  if (i > 0) {
+    b.data[i - 1] = readRegRdata();
+    checkWaveTrigger(b.regs[i - 1], b.data[i - 1]);
+  }
+  if (i < b.num) {
+    readRegRaddr(b.regs[i]);
+    return;
   }
+
+  simCmd resp;
+  resp.id = regBatch.id;
+  resp.cmd = READ_REGS;
+  memcpy(resp.data, &b, sizeof(simRegBatch));
+  resp.size = sizeof(simRegBatch);
+  respChannel->send(&resp);
+  regBatch.active = false;
 }
 
 extern "C" {
@@ -79,6 +183,7 @@ extern "C" {
     bool exitTick = false;
     int finishSim = 0;
     getCycles((long long int*)(&numCycles));
+    cycleWaves();
 
     // Handle pending operations, if any
     if (pendingOps.size() > 0) {
@@ -94,14 +199,10 @@ extern "C" {
             simCmd resp;
             resp.id = cmd->id;
             resp.cmd = cmd->cmd;
-            SV_BIT_PACKED_ARRAY(32, rdataHi);
-            SV_BIT_PACKED_ARRAY(32, rdataLo);
-            readRegRdataHi32((svBitVec32*)&rdataHi);
-            readRegRdataLo32((svBitVec32*)&rdataLo);
-            *(uint32_t*)resp.data = (uint32_t)*rdataLo;
-            *((uint32_t*)resp.data + 1) = (uint32_t)*rdataHi;
+            *(uint64_t*)resp.data = readRegRdata();
             resp.size = sizeof(uint64_t);
             respChannel->send(&resp);
+            checkWaveTrigger(*(uint32_t*)cmd->data, *(uint64_t*)resp.data);
             break;
           default:
             EPRINTF("[SIM] Ignoring unknown pending command %u\n", cmd->cmd);
@@ -117,8 +218,20 @@ extern "C" {
     // Drain an element from DRAM queue if it exists
     checkAndSendDRAMResponse();
 
-    // Check if input stream has new data
-    inStream->send();
+    // Offer input stream data, and refill output stream credit
+    cycleStreams();
+
+    // Design is running by itself; the host is waiting for one reply
+    if (runUntilDone.active) {
+      runUntilDoneCycle();
+      return finishSim;
+    }
+
+    // Register batch in progress
+    if (regBatch.active) {
+      regBatchCycle();
+      return finishSim;
+    }
 
     // Handle new incoming operations
     while (!exitTick) {
@@ -129,16 +242,17 @@ extern "C" {
       switch (cmd->cmd) {
         case MALLOC: {
           size_t size = *(size_t*)cmd->data;
-          int fd = open("/dev/zero", O_RDWR);
-          void *ptr = mmap(0, size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
-          close(fd);
+          void *ptr = deviceMemory->alloc(size);
+          ASSERT(ptr != NULL, "[SIM] MALLOC(%lu): device memory arena (%lu MB) exhausted, raise DRAM_ARENA_SIZE_MB\n", size, deviceMemory->size() >> 20);
 
           uint32_t smallPtr = remapper->remap((uint64_t)ptr, size);
           simCmd resp;
           resp.id = cmd->id;
           resp.cmd = cmd->cmd;
-          *(uint64_t*)resp.data = (uint64_t)smallPtr;
-          resp.size = sizeof(size_t);
+          uint64_t *respData = (uint64_t*)resp.data;
+          respData[0] = (uint64_t)smallPtr;
+          respData[1] = deviceMemory->offsetOf(ptr);  // Where the host finds the buffer in shared device memory
+          resp.size = 2 * sizeof(uint64_t);
           EPRINTF("[SIM] MALLOC(%lu), returning %x - %x (%p - %p)\n", size, smallPtr, smallPtr + size, (void*)ptr, (void*)((uint8_t*)ptr + size));
           respChannel->send(&resp);
           break;
@@ -146,7 +260,13 @@ extern "C" {
         case FREE: {
           void *ptr = (void*)(*(uint64_t*)cmd->data);
           ASSERT(ptr != NULL, "Attempting to call free on null pointer\n");
-          EPRINTF("[SIM] FREE(%p)\n", ptr);
+          AddrRemapper::Allocation freed;
+          if (remapper->unmap((uint32_t)(uint64_t)ptr, &freed)) {
+            EPRINTF("[SIM] FREE(%p), releasing %lu bytes at %p\n", ptr, freed.size, (void*)freed.bigAddr);
+            deviceMemory->free((void*)freed.bigAddr);
+          } else {
+            EPRINTF("[SIM] FREE(%p): not the start of a live allocation, ignoring\n", ptr);
+          }
           break;
         }
         case MEMCPY_H2D: {
@@ -156,16 +276,23 @@ extern "C" {
 
           uint64_t bigptr = remapper->getBig((uint64_t)dst);
 
-          EPRINTF("[SIM] Received memcpy request to %p (%p), size %lu\n", (void*)dst, (uint64_t*)bigptr, size);
-
-          // Now to receive 'size' bytes from the cmd stream
-          cmdChannel->recvFixedBytes((uint64_t*)bigptr, size);
-
-          // Send ack back indicating end of memcpy
           simCmd resp;
           resp.id = cmd->id;
           resp.cmd = cmd->cmd;
-          resp.size = 0;
+          if (deviceMemory->isShared()) {
+            // The host copies straight into shared device memory; tell it where
+            ASSERT(deviceMemory->contains((void*)bigptr, size), "[SIM] memcpy of %lu bytes to %p overruns device memory\n", size, dst);
+            *(uint64_t*)resp.data = deviceMemory->offsetOf((void*)bigptr);
+            resp.size = sizeof(uint64_t);
+          } else {
+            EPRINTF("[SIM] Received memcpy request to %p (%p), size %lu\n", (void*)dst, (uint64_t*)bigptr, size);
+
+            // Now to receive 'size' bytes from the cmd stream
+            cmdChannel->recvFixedBytes((uint64_t*)bigptr, size);
+
+            // Ack indicating end of memcpy
+            resp.size = 0;
+          }
           respChannel->send(&resp);
           break;
         }
@@ -177,8 +304,19 @@ extern "C" {
 
           uint64_t bigptr = remapper->getBig((uint64_t)src);
 
-          // Now to receive 'size' bytes from the cmd stream
-          respChannel->sendFixedBytes((uint64_t*)bigptr, size);
+          if (deviceMemory->isShared()) {
+            // The host copies straight out of shared device memory; tell it where
+            ASSERT(deviceMemory->contains((void*)bigptr, size), "[SIM] memcpy of %lu bytes from %p overruns device memory\n", size, src);
+            simCmd resp;
+            resp.id = cmd->id;
+            resp.cmd = cmd->cmd;
+            *(uint64_t*)resp.data = deviceMemory->offsetOf((void*)bigptr);
+            resp.size = sizeof(uint64_t);
+            respChannel->send(&resp);
+          } else {
+            // Now to send 'size' bytes on the resp stream
+            respChannel->sendFixedBytes((uint64_t*)bigptr, size);
+          }
           break;
         }
         case RESET:
@@ -192,10 +330,61 @@ extern "C" {
         case STEP: {
           exitTick = true;
           if (!useIdealDRAM) {
-            mem->update();
+            updateDRAM();
           }
           break;
         }
+        case RUN_UNTIL_DONE: {
+          uint64_t *data = (uint64_t*)cmd->data;
+          readRegRaddr((uint32_t)data[0]);
+          runUntilDone.id = cmd->id;
+          runUntilDone.reg = (uint32_t)data[0];
+          runUntilDone.pollPhase = 0;
+          runUntilDone.startCycles = numCycles;
+          runUntilDone.maxCycles = data[1];
+          runUntilDone.nextPrint = runProgressInterval;
+          runUntilDone.active = true;
+          runUntilDoneCycle();
+          exitTick = true;
+          break;
+        }
+        case CHECKPOINT:
+        case RESTORE: {
+          // Reply data[0]: 1 == done, 0 == DRAM is busy, try again later; data[1]: checkpoint's cycle
+          char path[maxSimCmdDataSize + 1];
+          memcpy(path, cmd->data, maxSimCmdDataSize);
+          path[maxSimCmdDataSize] = 0;
+          simCmd resp;
+          resp.id = cmd->id;
+          resp.cmd = cmd->cmd;
+          uint64_t *respData = (uint64_t*)resp.data;
+          if (cmd->cmd == CHECKPOINT) {
+            respData[0] = saveCheckpoint(path) ? 1 : 0;
+            respData[1] = numCycles;
+          } else {
+            respData[1] = loadCheckpoint(path);
+            respData[0] = 1;
+          }
+          resp.size = 2 * sizeof(uint64_t);
+          respChannel->send(&resp);
+          break;
+        }
+        case READ_REGS:
+        case WRITE_REGS: {
+          memcpy(&regBatch.batch, cmd->data, sizeof(simRegBatch));
+          ASSERT(regBatch.batch.num <= maxRegsPerCmd, "[SIM] Register batch of %u registers, at most %u are supported\n", regBatch.batch.num, maxRegsPerCmd);
+          if (regBatch.batch.num > 0) {
+            regBatch.id = cmd->id;
+            regBatch.cmd = cmd->cmd;
+            regBatch.cycle = 0;
+            regBatch.active = true;
+            regBatchCycle();
+          } else if (cmd->cmd == READ_REGS) {
+            respChannel->send(cmd);
+          }
+          exitTick = true;
+          break;
+        }
         case GET_CYCLES: {
           exitTick = true;
           simCmd resp;
@@ -229,14 +418,21 @@ extern "C" {
 
             // Perform write
             writeReg(reg, data);
+            checkWaveTrigger(reg, data);
             exitTick = true;
             break;
           }
         case FIN:
           if (!useIdealDRAM) {
+            syncDRAM();
             mem->printStats(true);
           }
-          fclose(traceFp);
+          printPoolStatsVerbose();
+          coalescingCache.printStats();
+          deviceMemory->printStats();
+          closeDRAMTrace();
+          flushStreams();
+          finishWaves();
           finishSim = 1;
 
           simCmd resp;
@@ -270,12 +466,29 @@ extern "C" {
     EPRINTF("[SIM] Sim process started!\n");
     prctl(PR_SET_PDEATHSIG, SIGHUP);
 
+    // Write traces, logs and stream files in the directory the host picked for this run
+    char *workDir = getenv("SIM_WORKDIR");
+    if (workDir != NULL && workDir[0] != 0) {
+      ASSERT(chdir(workDir) == 0, "[SIM] Unable to enter SIM_WORKDIR %s: %s\n", workDir, strerror(errno));
+      EPRINTF("[SIM] Working directory: %s\n", workDir);
+    }
+
     /**
      * Open slave interface to host {
      */
-      // 0. Create Channel structures
-      cmdChannel = new Channel(SIM_CMD_FD, -1, sizeof(simCmd));
-      respChannel = new Channel(-1, SIM_RESP_FD, sizeof(simCmd));
+      // 0. Create Channel structures, over the host's shared-memory rings if it passed them
+      ShmRing *cmdRing, *respRing;
+      if (mapShmRings(SIM_CHANNEL_FD, 0, &cmdRing, &respRing)) {
+        close(SIM_CHANNEL_FD);
+        cmdChannel = new Channel(cmdRing, sizeof(simCmd));
+        respChannel = new Channel(respRing, sizeof(simCmd));
+        cmdChannel->setPeer(getppid());
+        respChannel->setPeer(getppid());
+        EPRINTF("[SIM] Using shared-memory channel\n");
+      } else {
+        cmdChannel = new Channel(SIM_CMD_FD, -1, sizeof(simCmd));
+        respChannel = new Channel(-1, SIM_RESP_FD, sizeof(simCmd));
+      }
 
       // 1. Read command
       simCmd *cmd = (simCmd*) cmdChannel->recv();
@@ -287,31 +500,7 @@ extern "C" {
     /**
      * Set VPD / VCD based on environment variables
      */
-    char *vpd = getenv("VPD_ON");
-    if (vpd != NULL) {
-      if (vpd[0] != 0 && atoi(vpd) > 0) {
-        startVPD();
-        EPRINTF("[SIM] VPD Waveforms ENABLED\n");
-      } else {
-        EPRINTF("[SIM] VPD Waveforms DISABLED\n");
-      }
-    } else {
-      EPRINTF("[SIM] VPD Waveforms DISABLED\n");
-    }
-
-    char *vcd = getenv("VCD_ON");
-    if (vcd != NULL) {
-      if (vcd[0] != 0 && atoi(vcd) > 0) {
-        startVCD();
-        EPRINTF("[SIM] VCD Waveforms ENABLED\n");
-      } else {
-        EPRINTF("[SIM] VCD Waveforms DISABLED\n");
-      }
-    } else {
-      EPRINTF("[SIM] VCD Waveforms DISABLED\n");
-    }
-
-
+    initWaves();
 
     /**
      * Initialize peripheral simulators
@@ -0,0 +1,178 @@
+/**
+ * Reader for the binary DRAM traces written by DRAMTraceWriter (DRAM_TRACE=1)
+ *
+ * Usage: DRAMTraceReader [-t] [-w <cycles>] <trace_*.bin>
+ *   -t            Print every record in the legacy trace_*.log text format
+ *   -w <cycles>   Window size for the bandwidth histogram (default 10000)
+ * Without -t, prints a summary with latency and bandwidth histograms.
+ *
+ * Build: make tools
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "DRAMTrace.h"
+
+const int numLatencyBuckets = 24;  // Powers of 2 up to 8M cycles
+const int numBandwidthBuckets = 10;
+
+struct TypeStats {
+  uint64_t count = 0;
+  uint64_t bytes = 0;
+  uint64_t latencySum = 0;
+  uint32_t latencyMin = UINT32_MAX;
+  uint32_t latencyMax = 0;
+  uint64_t latencyHist[numLatencyBuckets] = {0};
+
+  void add(const DRAMTraceRecord &r) {
+    count++;
+    bytes += r.size;
+    latencySum += r.latency;
+    if (r.latency < latencyMin) latencyMin = r.latency;
+    if (r.latency > latencyMax) latencyMax = r.latency;
+    int b = 0;
+    while ((b < numLatencyBuckets - 1) && ((1U << (b+1)) <= r.latency)) b++;
+    latencyHist[b]++;
+  }
+};
+
+void printBar(uint64_t value, uint64_t max) {
+  int width = (max == 0) ? 0 : (int)((value * 50) / max);
+  for (int i = 0; i < width; i++) putchar('#');
+  putchar('\n');
+}
+
+void printLatency(const char *name, TypeStats &s) {
+  if (s.count == 0) return;
+  printf("\n%s: %lu bursts, %lu bytes\n", name, s.count, s.bytes);
+  printf("  latency min / avg / max : %u / %.1f / %u cycles\n", s.latencyMin, (double)s.latencySum / s.count, s.latencyMax);
+  uint64_t maxBucket = 0;
+  for (int b = 0; b < numLatencyBuckets; b++) {
+    if (s.latencyHist[b] > maxBucket) maxBucket = s.latencyHist[b];
+  }
+  for (int b = 0; b < numLatencyBuckets; b++) {
+    if (s.latencyHist[b] == 0) continue;
+    printf("  [%7u, %7u) %10lu ", (b == 0) ? 0 : (1U << b), 1U << (b+1), s.latencyHist[b]);
+    printBar(s.latencyHist[b], maxBucket);
+  }
+}
+
+int main(int argc, char **argv) {
+  bool text = false;
+  uint64_t window = 10000;
+  int opt;
+  while ((opt = getopt(argc, argv, "tw:")) != -1) {
+    switch (opt) {
+      case 't': text = true; break;
+      case 'w': window = strtoull(optarg, NULL, 0); break;
+      default:
+        fprintf(stderr, "Usage: %s [-t] [-w <cycles>] <trace.bin>\n", argv[0]);
+        return 1;
+    }
+  }
+  if (optind >= argc || window == 0) {
+    fprintf(stderr, "Usage: %s [-t] [-w <cycles>] <trace.bin>\n", argv[0]);
+    return 1;
+  }
+
+  const char *filename = argv[optind];
+  FILE *fp = fopen(filename, "rb");
+  if (fp == NULL) {
+    fprintf(stderr, "Unable to open %s\n", filename);
+    return 1;
+  }
+
+  DRAMTraceHeader header;
+  if ((fread(&header, sizeof(header), 1, fp) != 1) || (memcmp(header.magic, DRAM_TRACE_MAGIC, sizeof(header.magic)) != 0)) {
+    fprintf(stderr, "%s is not a binary DRAM trace\n", filename);
+    return 1;
+  }
+  if (header.recordSize != sizeof(DRAMTraceRecord)) {
+    fprintf(stderr, "%s: record size %u does not match reader (%lu)\n", filename, header.recordSize, sizeof(DRAMTraceRecord));
+    return 1;
+  }
+
+  TypeStats stats[2];
+  std::map<uint64_t, uint64_t> windowBytes;   // Completion window -> bytes
+  std::map<uint32_t, uint64_t> channelBytes;
+  uint64_t firstCycle = UINT64_MAX;
+  uint64_t lastCycle = 0;
+
+  std::vector<DRAMTraceRecord> buf(1 << 16);
+  size_t n;
+  while ((n = fread(&buf[0], sizeof(DRAMTraceRecord), buf.size(), fp)) > 0) {
+    for (size_t i = 0; i < n; i++) {
+      DRAMTraceRecord &r = buf[i];
+      if (text) {
+        printf("id: %lu\n", r.id);
+        printf("issue: %lu\n", r.issued);
+        printf("type: %s\n", (r.type == TRACE_STORE) ? "STORE" : "LOAD");
+        printf("delay: %u\n", r.latency);
+        printf("addr: %lu\n", r.addr);
+        printf("size: %u\n", r.size);
+        printf("channel: %u\n", r.channel);
+        printf("\n");
+        continue;
+      }
+
+      uint64_t done = r.issued + r.latency;
+      if (r.issued < firstCycle) firstCycle = r.issued;
+      if (done > lastCycle) lastCycle = done;
+      stats[r.type == TRACE_STORE ? 1 : 0].add(r);
+      windowBytes[done / window] += r.size;
+      channelBytes[r.channel] += r.size;
+    }
+  }
+  fclose(fp);
+  if (text) return 0;
+
+  uint64_t count = stats[0].count + stats[1].count;
+  uint64_t bytes = stats[0].bytes + stats[1].bytes;
+  printf("Trace        : %s (%s, %u-byte bursts)\n", filename, (header.source == TRACE_N3XT) ? "ideal DRAM" : "DRAMSim2", header.burstSizeBytes);
+  printf("Bursts       : %lu (%lu loads, %lu stores)\n", count, stats[0].count, stats[1].count);
+  if (count == 0) return 0;
+
+  uint64_t span = lastCycle - firstCycle + 1;
+  printf("Cycles       : %lu - %lu (%lu)\n", firstCycle, lastCycle, span);
+  printf("Bandwidth    : %.3f bytes/cycle average\n", (double)bytes / span);
+
+  printLatency("Loads", stats[0]);
+  printLatency("Stores", stats[1]);
+
+  // Histogram of per-window bandwidth, including idle windows
+  uint64_t numWindows = lastCycle / window - firstCycle / window + 1;
+  uint64_t maxWindowBytes = 0;
+  for (std::map<uint64_t, uint64_t>::iterator it = windowBytes.begin(); it != windowBytes.end(); it++) {
+    if (it->second > maxWindowBytes) maxWindowBytes = it->second;
+  }
+  uint64_t bwHist[numBandwidthBuckets + 1] = {0};  // Bucket 0 holds idle windows
+  bwHist[0] = numWindows - windowBytes.size();
+  for (std::map<uint64_t, uint64_t>::iterator it = windowBytes.begin(); it != windowBytes.end(); it++) {
+    int b = (int)((it->second * numBandwidthBuckets - 1) / maxWindowBytes);
+    bwHist[b + 1]++;
+  }
+  uint64_t maxBucket = 0;
+  for (int b = 0; b <= numBandwidthBuckets; b++) {
+    if (bwHist[b] > maxBucket) maxBucket = bwHist[b];
+  }
+  double maxBw = (double)maxWindowBytes / window;
+  printf("\nBandwidth per %lu-cycle window (bytes/cycle), %lu windows:\n", window, numWindows);
+  printf("  %-17s %10lu ", "idle", bwHist[0]);
+  printBar(bwHist[0], maxBucket);
+  for (int b = 0; b < numBandwidthBuckets; b++) {
+    printf("  (%6.2f, %6.2f] %10lu ", maxBw * b / numBandwidthBuckets, maxBw * (b+1) / numBandwidthBuckets, bwHist[b + 1]);
+    printBar(bwHist[b + 1], maxBucket);
+  }
+
+  printf("\nBytes per channel:\n");
+  for (std::map<uint32_t, uint64_t>::iterator it = channelBytes.begin(); it != channelBytes.end(); it++) {
+    printf("  %4u: %lu\n", it->first, it->second);
+  }
+  return 0;
+}
@@ -0,0 +1,249 @@
+/**
+ * Feeds a live simulation input stream (STREAM_IN_FILES=unix:<path>, or a
+ * FIFO) from a pcap capture or a binary file, paced to a target rate
+ *
+ * Usage: StreamReplayer [options] <input> <destination>
+ *   <input>          Classic pcap capture (one packet per record), or a binary file
+ *   <destination>    unix:<path> to connect to the simulator's socket, or a FIFO / file
+ *   -f raw|tagged    Output format, to match STREAM_IN_FORMAT (default tagged: tag is
+ *                    the packet number, last is set on each packet's final word)
+ *   -s <bytes>       Packet size when <input> is not a pcap capture (default 64)
+ *   -r <Mbit/s>      Pace to a bit rate
+ *   -p <packets/s>   Pace to a packet rate
+ *   -t <speedup>     Pace by the capture's timestamps, <speedup> times faster
+ *   -b <packets>     Send packets in back-to-back bursts of this size (default 1)
+ *   -l <count>       Replay the input this many times (default 1, 0 = forever)
+ * Without -r, -p or -t, packets are sent as fast as the simulator takes them.
+ * Packets are padded with zeros to whole 32-bit words.
+ *
+ * Build: make tools
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+const uint32_t pcapMagicMicros = 0xa1b2c3d4;
+const uint32_t pcapMagicNanos = 0xa1b23c4d;
+const int connectTimeoutSeconds = 60;
+
+struct Packet {
+  uint64_t timestampNs;   // Capture time, 0 for binary input
+  std::vector<uint8_t> bytes;
+};
+
+uint32_t swap32(uint32_t v) {
+  return ((v & 0xff) << 24) | ((v & 0xff00) << 8) | ((v >> 8) & 0xff00) | (v >> 24);
+}
+
+// Classic pcap, either byte order; false if 'f' is not a pcap capture
+bool readPcap(FILE *f, std::vector<Packet> &packets) {
+  uint32_t header[6];
+  if (fread(header, sizeof(header), 1, f) != 1) return false;
+  bool swapped = (header[0] == swap32(pcapMagicMicros)) || (header[0] == swap32(pcapMagicNanos));
+  uint32_t magic = swapped ? swap32(header[0]) : header[0];
+  if ((magic != pcapMagicMicros) && (magic != pcapMagicNanos)) return false;
+  uint64_t fractionNs = (magic == pcapMagicNanos) ? 1 : 1000;
+
+  uint32_t record[4];   // Seconds, fraction, captured length, original length
+  while (fread(record, sizeof(record), 1, f) == 1) {
+    for (int i = 0; i < 4; i++) {
+      if (swapped) record[i] = swap32(record[i]);
+    }
+    Packet p;
+    p.timestampNs = (uint64_t)record[0] * 1000000000 + record[1] * fractionNs;
+    p.bytes.resize(record[2]);
+    if ((record[2] > 0) && (fread(&p.bytes[0], record[2], 1, f) != 1)) {
+      fprintf(stderr, "Truncated packet %lu in capture, ignored\n", packets.size());
+      break;
+    }
+    packets.push_back(p);
+  }
+  return true;
+}
+
+void readBinary(FILE *f, size_t packetSize, std::vector<Packet> &packets) {
+  std::vector<uint8_t> chunk(packetSize);
+  size_t n;
+  while ((n = fread(&chunk[0], 1, packetSize, f)) > 0) {
+    Packet p;
+    p.timestampNs = 0;
+    p.bytes.assign(chunk.begin(), chunk.begin() + n);
+    packets.push_back(p);
+  }
+}
+
+// Retries until the simulator listens on the socket
+int connectUnix(const char *path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Socket path %s is too long\n", path);
+    return -1;
+  }
+  strcpy(addr.sun_path, path);
+  for (int tries = 0; tries < connectTimeoutSeconds * 10; tries++) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) break;
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) return fd;
+    close(fd);
+    if ((errno != ENOENT) && (errno != ECONNREFUSED)) break;
+    usleep(100000);
+  }
+  fprintf(stderr, "Unable to connect to %s: %s\n", path, strerror(errno));
+  return -1;
+}
+
+bool writeAll(int fd, const uint8_t *bytes, size_t size) {
+  while (size > 0) {
+    ssize_t written = write(fd, bytes, size);
+    if ((written < 0) && (errno == EINTR)) continue;
+    if (written <= 0) return false;
+    bytes += written;
+    size -= written;
+  }
+  return true;
+}
+
+// Packet bytes as stream records: raw 32-bit words, or {data, tag, flags} triples
+void encode(const Packet &p, uint32_t tag, bool tagged, std::vector<uint32_t> &out) {
+  size_t numWords = (p.bytes.size() + 3) / 4;
+  for (size_t w = 0; w < numWords; w++) {
+    uint32_t word = 0;
+    memcpy(&word, &p.bytes[w * 4], std::min((size_t)4, p.bytes.size() - w * 4));
+    out.push_back(word);
+    if (tagged) {
+      out.push_back(tag);
+      out.push_back((w == numWords - 1) ? 1 : 0);
+    }
+  }
+}
+
+uint64_t nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void sleepUntil(uint64_t ns) {
+  struct timespec ts;
+  ts.tv_sec = ns / 1000000000;
+  ts.tv_nsec = ns % 1000000000;
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+void usage(const char *name) {
+  fprintf(stderr, "Usage: %s [-f raw|tagged] [-s <bytes>] [-r <Mbit/s> | -p <packets/s> | -t <speedup>] [-b <packets>] [-l <count>] <input> <destination>\n", name);
+}
+
+int main(int argc, char **argv) {
+  bool tagged = true;
+  size_t packetSize = 64;
+  double mbps = 0;
+  double pps = 0;
+  double speedup = 0;
+  int burst = 1;
+  int loops = 1;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "f:s:r:p:t:b:l:")) != -1) {
+    switch (opt) {
+      case 'f': tagged = (strcmp(optarg, "raw") != 0); break;
+      case 's': packetSize = atoi(optarg); break;
+      case 'r': mbps = atof(optarg); break;
+      case 'p': pps = atof(optarg); break;
+      case 't': speedup = atof(optarg); break;
+      case 'b': burst = atoi(optarg); break;
+      case 'l': loops = atoi(optarg); break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+  if ((optind + 2 != argc) || (packetSize == 0) || (burst <= 0)) {
+    usage(argv[0]);
+    return 1;
+  }
+  const char *input = argv[optind];
+  const char *destination = argv[optind + 1];
+
+  FILE *f = fopen(input, "rb");
+  if (f == NULL) {
+    fprintf(stderr, "Unable to open %s\n", input);
+    return 1;
+  }
+  std::vector<Packet> packets;
+  bool pcap = readPcap(f, packets);
+  if (!pcap) {
+    rewind(f);
+    readBinary(f, packetSize, packets);
+  }
+  fclose(f);
+  if (packets.empty()) {
+    fprintf(stderr, "%s has no packets\n", input);
+    return 1;
+  }
+  if ((speedup > 0) && !pcap) {
+    fprintf(stderr, "-t needs a pcap capture\n");
+    return 1;
+  }
+
+  int fd;
+  if (strncmp(destination, "unix:", 5) == 0) {
+    fd = connectUnix(destination + 5);
+  } else {
+    fd = open(destination, O_WRONLY);   // Waits for the simulator to open a FIFO
+    if (fd == -1) fprintf(stderr, "Unable to open %s: %s\n", destination, strerror(errno));
+  }
+  if (fd == -1) return 1;
+  fprintf(stderr, "%lu %s packets from %s -> %s, %s format\n", packets.size(), pcap ? "pcap" : "binary", input, destination, tagged ? "tagged" : "raw");
+
+  // Packets are sent burst by burst, each one as soon as its first packet is due
+  uint64_t start = nowNs();
+  uint64_t due = start;
+  uint64_t sentPackets = 0;
+  uint64_t sentBytes = 0;
+  std::vector<uint32_t> records;
+  for (int loop = 0; (loops == 0) || (loop < loops); loop++) {
+    uint64_t loopStart = due;
+    for (size_t i = 0; i < packets.size(); i += burst) {
+      size_t burstEnd = std::min(packets.size(), i + burst);
+      if (speedup > 0) {
+        due = loopStart + (uint64_t)((packets[i].timestampNs - packets[0].timestampNs) / speedup);
+      }
+      sleepUntil(due);
+
+      records.clear();
+      for (size_t p = i; p < burstEnd; p++) {
+        encode(packets[p], (uint32_t)sentPackets++, tagged, records);
+        sentBytes += packets[p].bytes.size();
+        if (mbps > 0) due += (uint64_t)(packets[p].bytes.size() * 8 * 1000 / mbps);
+        if (pps > 0) due += (uint64_t)(1e9 / pps);
+      }
+      if (!writeAll(fd, (const uint8_t*)records.data(), records.size() * sizeof(uint32_t))) {
+        fprintf(stderr, "Simulator closed the stream after %lu packets: %s\n", sentPackets, strerror(errno));
+        close(fd);
+        return 1;
+      }
+    }
+    if (speedup > 0) {
+      due = loopStart + (uint64_t)((packets.back().timestampNs - packets[0].timestampNs) / speedup);
+    }
+  }
+  close(fd);
+
+  double seconds = (nowNs() - start) / 1e9;
+  fprintf(stderr, "Sent %lu packets, %lu bytes in %.3f s (%.1f packets/s, %.3f Mbit/s)\n", sentPackets, sentBytes, seconds,
+      (seconds > 0) ? sentPackets / seconds : 0, (seconds > 0) ? sentBytes * 8 / seconds / 1e6 : 0);
+  return 0;
+}
@@ -1,52 +1,164 @@
-#include <unistd.h>
-#include <errno.h>
-#include <cstring>
-#include <string>
-#include <cstdlib>
+#ifndef __COALESCING_CACHE_H
+#define __COALESCING_CACHE_H
+
 #include <stdio.h>
+#include <stdint.h>
 #include <vector>
-#include <queue>
-#include <map>
-#include <poll.h>
-#include <fcntl.h>
-#include <signal.h>
-#include <sys/mman.h>
-#include <sys/prctl.h>
 using namespace std;
 
-#include "vc_hdrs.h"
-#include "svdpi_src.h"
-
-#include <DRAMSim.h>
+#include "commonDefs.h"
+#include <FlatHashMap.h>
 
+/**
+ * Coalescing cache for sparse gather / scatter traffic
+ * A line is one burst-aligned address, in one direction (read or write),
+ * that has a DRAM transaction in flight. Callers that must not merge across
+ * streams also key lines by the command tag; it defaults to 0. Requests for a line that is already
+ * in flight are merged into it instead of issuing another transaction, and
+ * complete together with the line's first request (its leader). At most
+ * 'maxLines' lines are tracked; -1 == unbounded.
+ */
+template <class T>
 class CoalescingCache {
 public:
+  struct Line {
+    uint64_t addr;
+    bool isWr;
+    uint64_t tag;
+    T leader;
+    vector<T> merged;   // Requests waiting on the leader's transaction, in arrival order
+  };
+
+private:
+  struct LineKey {
+    uint64_t addr;
+    bool isWr;
+    uint64_t tag;
+
+    LineKey() {
+      addr = 0;
+      isWr = false;
+      tag = 0;
+    }
+
+    LineKey(uint64_t a, bool wr, uint64_t t) {
+      addr = a;
+      isWr = wr;
+      tag = t;
+    }
+
+    uint64_t hash() const {
+      return mixHash64(addr, (tag << 1) | isWr);
+    }
+
+    bool operator==(const LineKey &o) const {
+      return addr == o.addr && isWr == o.isWr && tag == o.tag;
+    }
+  };
+
+  FlatHashMap<LineKey, Line*> lines;
+  vector<Line*> freeLines;    // Retired lines, reused to avoid allocating per miss
+  int64_t maxLines;
+
+public:
+  // Statistics, indexed by isWr
+  uint64_t lookups[2] = {0, 0};
+  uint64_t hits[2] = {0, 0};      // Requests merged into a line already in flight
+  uint64_t bypasses[2] = {0, 0};  // Misses that found the cache full
+  uint64_t maxOccupancy = 0;
 
-  uint64_t maxLines = 0;
-  std::map<uint64_t, uint32_t*> cache;
+  CoalescingCache(int64_t maxLines = -1) : lines(1024), maxLines(maxLines) {
+  }
+
+  void setCapacity(int64_t n) {
+    maxLines = n;
+  }
+
+  int64_t capacity() {
+    return maxLines;
+  }
 
-  CoalescingCache(uint64_t lines) {
-    maxLines = lines;
+  size_t size() {
+    return lines.size();
   }
 
   bool isFull() {
-    return (cache.size == maxLines);
+    return (maxLines >= 0) && ((int64_t)lines.size() >= maxLines);
   }
 
   bool isEmpty() {
-    return (cache.size == 0);
+    return (lines.size() == 0);
   }
 
-  void write(uint64_t addr) {
+  // Returns the in-flight line for (addr, isWr, tag), or NULL on a miss
+  Line* find(uint64_t addr, bool isWr, uint64_t tag = 0) {
+    lookups[isWr]++;
+    Line **it = lines.find(LineKey(addr, isWr, tag));
+    return (it == NULL) ? NULL : *it;
+  }
 
+  // Attach 'req' to a line returned by find()
+  void merge(Line *line, T req) {
+    hits[line->isWr]++;
+    line->merged.push_back(req);
   }
 
-  void readEvict(uint64_t addr) {
+  // Start tracking a new line led by 'leader'; returns NULL (bypass) when full
+  Line* allocate(uint64_t addr, bool isWr, T leader, uint64_t tag = 0) {
+    if (isFull()) {
+      bypasses[isWr]++;
+      return NULL;
+    }
+    Line *line;
+    if (freeLines.empty()) {
+      line = new Line;
+    } else {
+      line = freeLines.back();
+      freeLines.pop_back();
+    }
+    line->addr = addr;
+    line->isWr = isWr;
+    line->tag = tag;
+    line->leader = leader;
+    lines.insert(LineKey(addr, isWr, tag), line);
+    if (lines.size() > maxOccupancy) maxOccupancy = lines.size();
+    return line;
+  }
 
+  /**
+   * The transaction issued for 'leader' has completed: call f(req) for every
+   * request merged into its line and retire the line. Does nothing if
+   * 'leader' bypassed the cache.
+   */
+  template <class F>
+  void complete(uint64_t addr, bool isWr, T leader, F f, uint64_t tag = 0) {
+    LineKey key(addr, isWr, tag);
+    Line **it = lines.find(key);
+    if ((it == NULL) || ((*it)->leader != leader)) return;
+    Line *line = *it;
+    lines.erase(key);
+    for (size_t i = 0; i < line->merged.size(); i++) {
+      f(line->merged[i]);
+    }
+    line->merged.clear();
+    freeLines.push_back(line);
   }
 
+  void printStats() {
+    const char *names[2] = {"gather", "scatter"};
+    EPRINTF("[CoalescingCache] capacity: %ld lines, max occupancy: %lu lines\n", maxLines, maxOccupancy);
+    for (int i = 0; i < 2; i++) {
+      uint64_t issued = lookups[i] - hits[i];
+      EPRINTF("[CoalescingCache] %-7s: %lu requests, %lu merged (%.1f%%), %lu transactions issued, %lu bypassed (cache full)\n",
+        names[i], lookups[i], hits[i], (lookups[i] == 0) ? 0.0 : (100.0 * hits[i]) / lookups[i], issued, bypasses[i]);
+    }
+  }
 
   ~CoalescingCache() {
-
+    for (size_t i = 0; i < freeLines.size(); i++) {
+      delete freeLines[i];
+    }
   }
 };
+
+#endif // __COALESCING_CACHE_H
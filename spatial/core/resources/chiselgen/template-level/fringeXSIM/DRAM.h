@@ -17,6 +17,8 @@ using namespace std;
 #include "vc_hdrs.h"
 #include "svdpi_src.h"
 
+#include <FlatHashMap.h>
+#include <CoalescingCache.h>
 #include <DRAMSim.h>
 
 #define MAX_NUM_Q             128
@@ -36,10 +38,13 @@ uint32_t burstSizeWords = burstSizeBytes / wordSizeBytes;
 
 uint64_t sparseRequestCounter = 0;  // Used to provide unique tags to each sparse request
 
-int sparseCacheSize = -1; // Max. number of lines in cache; -1 == infinity
-
 class DRAMRequest;
 
+int sparseCacheSize = 0; // Max. number of lines in cache; 0 == no coalescing, -1 == infinity
+
+// Sparse requests to a line (address, tag) already in flight wait on its transaction
+CoalescingCache<DRAMRequest*> sparseRequestCache;
+
 /**
  * DRAM Command received from the design
  * One object could potentially create multiple DRAMRequests
@@ -154,11 +159,20 @@ struct AddrTag {
   uint64_t addr;
   uint64_t tag;
 
+  AddrTag() {
+    addr = 0;
+    tag = 0;
+  }
+
   AddrTag(uint64_t a, uint64_t t) {
     addr = a;
     tag = t;
   }
 
+  uint64_t hash() const {
+    return mixHash64(addr, tag);
+  }
+
 	bool operator==(const AddrTag &o) const {
 			return addr == o.addr && tag == o.tag;
 	}
@@ -178,8 +192,7 @@ std::deque<uint32_t*> wdataQ[MAX_NUM_Q];
 std::deque<DRAMRequest*> wrequestQ;
 
 // Internal book-keeping data structures
-std::map<struct AddrTag, DRAMRequest*> addrToReqMap;
-std::map<struct AddrTag, DRAMRequest**> sparseRequestCache;
+FlatHashMap<struct AddrTag, DRAMRequest*> addrToReqMap(16384);
 
 uint32_t getWordOffset(uint64_t addr) {
   return (addr & (burstSizeBytes - 1)) >> 2;   // TODO: Use parameters above!
@@ -491,23 +504,16 @@ public:
 
     // Find transaction, mark it as done, remove entry from map
     struct AddrTag at(addr, tag);
-    std::map<struct AddrTag, DRAMRequest*>::iterator it = addrToReqMap.find(at);
-    ASSERT(it != addrToReqMap.end(), "address/tag tuple (%lx, %lx) not found in addrToReqMap!", addr, tag);
-    DRAMRequest* req = it->second;
+    DRAMRequest **it = addrToReqMap.find(at);
+    ASSERT(it != NULL, "address/tag tuple (%lx, %lx) not found in addrToReqMap!", addr, tag);
+    DRAMRequest* req = *it;
     req->completed = true;
     addrToReqMap.erase(at);
 
-    if (req->isSparse) { // Mark all waiting transactions done
-      at.tag = at.tag & 0xFFFFFFFF;
-      std::map<struct AddrTag, DRAMRequest**>::iterator it = sparseRequestCache.find(at);
-      ASSERT(it != sparseRequestCache.end(), "Could not find (%lx, %lx) in sparseRequestCache!", addr, tag);
-      DRAMRequest **line = it->second;
-      for (int i = 0; i < 16; i++) {
-        if (line[i] != NULL) {
-          line[i]->completed = true;
-        }
-      }
-      sparseRequestCache.erase(at);
+    if (req->isSparse) { // Mark all requests merged into this line done
+      sparseRequestCache.complete(req->addr, req->isWr, req, [](DRAMRequest *r) {
+        r->completed = true;
+      }, req->tag);
     }
 
   }
@@ -515,7 +521,7 @@ public:
 
 bool sparseCacheFull() {
   if (sparseCacheSize == -1) return false;  // sparseRequestCache is infinitely large
-  else if (sparseRequestCache.size() <= sparseCacheSize) return false;
+  else if ((int64_t)sparseRequestCache.size() <= sparseCacheSize) return false;
   else return true;
 }
 
@@ -644,55 +650,47 @@ extern "C" {
         struct AddrTag at(req->addr, req->tag);
 
         if (!cmdIsSparse) { // Dense request
-          addrToReqMap[at] = req;
+          addrToReqMap.insert(at, req);
           skipIssue = false;
         } else {  // Sparse request
-          // Early out if cache is full
-          if (sparseCacheFull()) {
+          CoalescingCache<DRAMRequest*>::Line *line = NULL;
+          if (sparseCacheSize == 0) {  // No coalescing: every request issues its own transaction
+            skipIssue = false;
+          } else if (sparseCacheFull()) {  // Early out if cache is full
+            if (debug) EPRINTF("                  Sparse cache full, stall upstream\n");
             skipIssue = true;
             dramReady = 0;
           } else {
-            std::map<struct AddrTag, DRAMRequest**>::iterator it = sparseRequestCache.find(at);
             if (debug) EPRINTF("                  Sparse request, looking up (addr = %lx, tag = %lx)\n", at.addr, at.tag);
-            if (it == sparseRequestCache.end()) { // MISS
-              if (debug) EPRINTF("                  MISS, creating new cache line:\n");
+            line = sparseRequestCache.find(req->addr, req->isWr, req->tag);
+            if (line == NULL) { // MISS
+              if (debug) EPRINTF("                  MISS, creating new cache line\n");
+              sparseRequestCache.allocate(req->addr, req->isWr, req, req->tag);
               skipIssue = false;
-              DRAMRequest **line = new DRAMRequest*[16]; // One outstanding request per word
-              memset(line, 0, 16*sizeof(DRAMRequest*));
-              line[getWordOffset(cmdRawAddr)] = req;
-              if (debug) {
-                for (int i=0; i<16; i++) {
-                  EPRINTF("---- %p ", line[i]);
-                }
-                EPRINTF("\n");
-              }
-
-              sparseRequestCache[at] = line;
-
-              // Disambiguate each request with unique tag in the addr -> req mapping
-              uint64_t sparseTag = ((sparseRequestCounter++) << 32) | (cmdTag & 0xFFFFFFFF);
-              at.tag = sparseTag;
-              req->sparseTag = sparseTag;
-              addrToReqMap[at] = req;
-            } else {  // HIT
-              if (debug) EPRINTF("                  HIT, line:\n");
+            } else {  // HIT, waits on the line's transaction
               skipIssue = true;
-              DRAMRequest **line = it->second;
-              if (debug) {
-                for (int i=0; i<16; i++) {
-                  EPRINTF("---- %p ", line[i]);
-                }
-                EPRINTF("\n");
-              }
+            }
+          }
 
-              DRAMRequest *r = line[getWordOffset(cmdRawAddr)];
+          if (!skipIssue) {
+            // Disambiguate each request with unique tag in the addr -> req mapping
+            uint64_t sparseTag = ((sparseRequestCounter++) << 32) | (cmdTag & 0xFFFFFFFF);
+            at.tag = sparseTag;
+            req->sparseTag = sparseTag;
+            addrToReqMap.insert(at, req);
+          } else if (line != NULL) {
+            // One outstanding request per word
+            DRAMRequest *r = (getWordOffset(line->leader->rawAddr) == getWordOffset(cmdRawAddr)) ? line->leader : NULL;
+            for (size_t j = 0; (r == NULL) && (j < line->merged.size()); j++) {
+              if (getWordOffset(line->merged[j]->rawAddr) == getWordOffset(cmdRawAddr)) r = line->merged[j];
+            }
 
-              if (r != NULL) {  // Already a request waiting, stall upstream
-                if (debug) EPRINTF("                  Req %lx (%lx) already present for given word, stall upstream\n", r->addr, r->rawAddr);
-                dramReady = 0;
-              } else {  // Update word offset with request pointer
-                line[getWordOffset(cmdRawAddr)] = req;
-              }
+            if (r != NULL) {  // Already a request waiting, stall upstream
+              if (debug) EPRINTF("                  HIT, req %lx (%lx) already present for given word, stall upstream\n", r->addr, r->rawAddr);
+              dramReady = 0;
+            } else {
+              if (debug) EPRINTF("                  HIT, merged into line %lx\n", line->addr);
+              sparseRequestCache.merge(line, req);
             }
           }
         }
@@ -746,9 +744,10 @@ void initDRAM() {
     debug = false;
   }
 
+  // Same meaning as on VCS: unset or 0 == no coalescing, -1 == unbounded
   char *numOutstandingBursts = getenv("DRAM_NUM_OUTSTANDING_BURSTS");
   if (numOutstandingBursts != NULL) {
-    if (numOutstandingBursts[0] != 0 && atoi(numOutstandingBursts) > 0) {
+    if (numOutstandingBursts[0] != 0 && atoi(numOutstandingBursts) >= -1) {
       sparseCacheSize = atoi(numOutstandingBursts);
     }
   }
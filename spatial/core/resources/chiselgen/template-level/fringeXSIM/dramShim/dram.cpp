@@ -14,9 +14,11 @@ using namespace std;
 #include "DRAMRequest.h"
 #include "dramDefs.h"
 #include "channel.h"
+#include <DeviceArena.h>  // Shared with the VCS harness
 
 Channel *cmdChannel = NULL;
 Channel *respChannel = NULL;
+DeviceArena *deviceMemory = NULL;  // Backs every DRAM_MALLOC
 
 int sendResp(dramCmd *cmd) {
   dramCmd resp;
@@ -95,9 +97,8 @@ int tick() {
     switch (cmd->cmd) {
       case DRAM_MALLOC: {
         size_t size = *(size_t*)cmd->data;
-        int fd = open("/dev/zero", O_RDWR);
-        void *ptr = mmap(0, size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
-        close(fd);
+        void *ptr = deviceMemory->alloc(size);
+        ASSERT(ptr != NULL, "[SIM] MALLOC(%lu): device memory arena (%lu MB) exhausted, raise DRAM_ARENA_SIZE_MB\n", size, deviceMemory->size() >> 20);
 
         dramCmd resp;
         resp.id = cmd->id;
@@ -111,7 +112,11 @@ int tick() {
       case DRAM_FREE: {
         void *ptr = (void*)(*(uint64_t*)cmd->data);
         ASSERT(ptr != NULL, "Attempting to call free on null pointer\n");
-        EPRINTF("[SIM] FREE(%p)\n", ptr);
+        if (deviceMemory->free(ptr)) {
+          EPRINTF("[SIM] FREE(%p)\n", ptr);
+        } else {
+          EPRINTF("[SIM] FREE(%p): not a live allocation, ignoring\n", ptr);
+        }
         break;
       }
       case DRAM_MEMCPY_H2D: {
@@ -146,6 +151,7 @@ int tick() {
         exitTick = true;
         break;
       case DRAM_FIN:
+        deviceMemory->printStats();
         finishSim = 1;
         exitTick = true;
         break;
@@ -167,6 +173,7 @@ int main(int argc, char **argv) {
   // 0. Create Channel structures
   cmdChannel = new Channel(DRAM_CMD_FD, -1, sizeof(dramCmd));
   respChannel = new Channel(-1, DRAM_RESP_FD, sizeof(dramCmd));
+  deviceMemory = initDeviceArena();
 
   // 1. Read command
   dramCmd *cmd = (dramCmd*) cmdChannel->recv();
@@ -18,6 +18,18 @@ public:
   virtual void run() = 0;
   virtual void writeReg(uint32_t reg, uint64_t data) = 0;
   virtual uint64_t readReg(uint32_t reg) = 0;
+  // Bulk register access: regs[i] <- data[i] / data[i] <- regs[i] for i < num.
+  // Backends with a per-access round trip to save override these.
+  virtual void writeRegs(uint32_t num, const uint32_t *regs, const uint64_t *data) {
+    for (uint32_t i = 0; i < num; i++) {
+      writeReg(regs[i], data[i]);
+    }
+  }
+  virtual void readRegs(uint32_t num, const uint32_t *regs, uint64_t *data) {
+    for (uint32_t i = 0; i < num; i++) {
+      data[i] = readReg(regs[i]);
+    }
+  }
   virtual uint64_t getArg(uint32_t arg, bool isIO) = 0;
   virtual void setArg(uint32_t reg, uint64_t data, bool isIO) = 0;
   // user-defined APIs
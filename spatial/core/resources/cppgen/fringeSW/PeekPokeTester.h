@@ -5,7 +5,10 @@
 #include "verilated.h"
 #include "verilated_vcd_c.h"
 #include <iostream>
+#include <functional>
 #include <map>
+#include <string>
+#include <stdlib.h>
 
 class PeekPokeTester {
 typedef void (*CallbackFunction)(DUT*, PeekPokeTester*);
@@ -20,15 +23,79 @@ protected:
   VerilatedVcdC* tfp;
   signalCallbackMap watchMap; 
 
+  /**
+   * Waveform window, as for VCS:
+   *   WAVE_START=<cycle>     Do not dump before this cycle
+   *   WAVE_CYCLES=<n>        Stop after n cycles of dumping (0 == until the end)
+   *   WAVE_RING_CYCLES=<k>   Keep just the last k to 2k cycles, in DUT.ring0.vcd
+   *                          and DUT.ring1.vcd, alternating every k cycles
+   * and optionally a trigger (see triggerWaves) that must match first.
+   */
+  const uint64_t waveFlushInterval = 10000;
+  uint64_t waveStart = 0;
+  uint64_t waveCycles = 0;
+  uint64_t waveRingCycles = 0;
+  std::function<bool()> waveTrigger;
+  bool dumping = false;
+  bool wavesDone = false;
+  uint64_t waveWindowStart = 0;
+  uint64_t waveFileStart = 0;
+  int waveRingFile = 0;
+
+  static uint64_t waveEnv(const char *name) {
+    char *value = getenv(name);
+    return (value != NULL && value[0] != 0) ? strtoull(value, NULL, 0) : 0;
+  }
+
+  void openRingFile() {
+    std::string name = "DUT.ring" + std::to_string(waveRingFile) + ".vcd";
+    if (tfp->isOpen()) tfp->close();
+    tfp->open(name.c_str());
+    waveFileStart = numCycles;
+  }
+
+  // Start, stop, rotate and flush the dump; called every cycle
+  void updateWaves() {
+    if (!tfp || wavesDone) return;
+    if (!dumping) {
+      if ((numCycles >= waveStart) && (!waveTrigger || waveTrigger())) {
+        if (waveRingCycles > 0) openRingFile();
+        dumping = true;
+        waveWindowStart = numCycles;
+        std::cout << "[PeekPokeTester] Waveforms on at cycle " << numCycles << std::endl;
+      }
+    } else if ((waveCycles > 0) && (numCycles - waveWindowStart >= waveCycles)) {
+      tfp->flush();
+      dumping = false;
+      wavesDone = true;
+      std::cout << "[PeekPokeTester] Waveforms off at cycle " << numCycles << std::endl;
+    } else if ((waveRingCycles > 0) && (numCycles - waveFileStart >= waveRingCycles)) {
+      waveRingFile ^= 1;
+      openRingFile();
+    } else if ((numCycles - waveWindowStart) % waveFlushInterval == 0) {
+      tfp->flush();
+    }
+  }
+
 public:
     PeekPokeTester(DUT* _dut, VerilatedVcdC *_tfp = NULL) {
         dut = _dut;
         tfp = _tfp;
         main_time = 0L;
+        numCycles = 0;
         is_exit = false;
+        waveStart = waveEnv("WAVE_START");
+        waveCycles = waveEnv("WAVE_CYCLES");
+        waveRingCycles = waveEnv("WAVE_RING_CYCLES");
     }
 
     void init_dump(VerilatedVcdC* _tfp) { tfp = _tfp; }
+
+    // Hold off dumping until 'signal' equals 'value' (checked every cycle, from WAVE_START on)
+    template <typename T>
+    void triggerWaves(T *signal, T value) {
+      waveTrigger = [signal, value]() { return *signal == value; };
+    }
     inline bool exit() { return is_exit; }
     virtual inline double get_time_stamp() {
         return main_time;
@@ -52,21 +119,25 @@ public:
         // updated values are visible on waveform
         dut->clock = 1;
         dut->eval();
-        if (tfp) tfp->dump(++main_time);
-        tfp->flush();
+        if (dumping) {
+          tfp->dump(++main_time);
+          tfp->flush();
+        }
         is_exit = true;
     }
 
     void step() {
+        updateWaves();
+
         // Set all poke/peek values on leading edge
         dut->clock = 1;
         dut->eval();
-        if (tfp) tfp->dump(main_time);
+        if (dumping) tfp->dump(main_time);
         main_time++;
 
         dut->clock = 0;
         dut->eval();
-        if (tfp) tfp->dump(main_time);
+        if (dumping) tfp->dump(main_time);
         main_time++;
 
         // Eval again on leading edge of current clock cycle
@@ -75,14 +146,9 @@ public:
         // Do not advance main_time, as we have already done so above
         dut->clock = 1;
         dut->eval();
-        if (tfp) tfp->dump(main_time);
+        if (dumping) tfp->dump(main_time);
         numCycles++;
 
-        // Flush after certain number of cycles
-        if (numCycles % 10 == 0) {
-          tfp->flush();
-        }
-
         // Some functions (e.g. monitor DRAM queue, send DRAM response)
         // needs to be executed every cycle
         if (numCycles % 107 == 0) {
@@ -103,7 +169,7 @@ public:
     }
     void update() {
         dut->_eval_settle(dut->__VlSymsp);
-        if (tfp) tfp->dump(main_time);
+        if (dumping) tfp->dump(main_time);
     }
 
     void run() {
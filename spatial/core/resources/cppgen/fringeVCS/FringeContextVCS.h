@@ -7,12 +7,15 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <deque>
+#include <map>
 #include <cstdlib>
 #include <cstring>
 #include <fcntl.h>
 #include <errno.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <sys/mman.h>
 
 #include "FringeContextBase.h"
 #include "simDefs.h"
@@ -27,6 +30,7 @@ class FringeContextVCS : public FringeContextBase<void> {
   Channel *respChannel;
   int initialCycles = -1;
   uint64_t numCycles = 0;
+  uint32_t runStatus = 0;
   uint32_t numArgIns = 0;
   uint32_t numArgInsId = 0;
   uint32_t numArgOuts = 0;
@@ -38,12 +42,29 @@ class FringeContextVCS : public FringeContextBase<void> {
   posix_spawn_file_actions_t action;
   int globalID = 1;
 
+  // Command and response rings shared with the simulator, -1 == pipes
+  int channelFd = -1;
+  const uint64_t channelRingBytes = 1 << 20;
+
+  // Device memory shared with the simulator; NULL == memcpy data goes through the channels
+  int devMemFd = -1;
+  uint8_t *devMem = NULL;
+  size_t devMemSize = 0;
+  std::map<uint64_t, std::pair<uint64_t, size_t> > devBuffers;  // Device address -> (offset in devMem, bytes)
+
   const uint32_t burstSizeBytes = 64;
   const uint32_t commandReg = 0;
   const uint32_t statusReg = 1;
   uint64_t maxCycles = 10000000000;
   uint64_t stepCount = 0;
 
+  // Checkpoints: SIM_CHECKPOINT_SAVE is written before the first run(); buffers
+  // restored from SIM_CHECKPOINT_RESTORE are handed out again by malloc, in order,
+  // and memcpys into them are skipped until the first run() if the data matches
+  std::string checkpointSaveFile;
+  std::deque<simCheckpointAllocation> replayAllocs;
+  std::map<uint64_t, size_t> replayedBufs;   // Device address -> bytes
+
   // Debug flags
   bool debugRegs = false;
 
@@ -56,11 +77,35 @@ class FringeContextVCS : public FringeContextBase<void> {
     "USE_IDEAL_DRAM",
     "DRAM_DEBUG",
     "DRAM_NUM_OUTSTANDING_BURSTS",
+    "DRAM_TRACE",
+    "DRAM_RESPONSES_PER_CYCLE",
+    "DRAM_ARENA_SIZE_MB",
+    "DRAM_ARENA_HUGEPAGES",
+    "DRAM_ARENA_PREFAULT",
     "VPD_ON",
     "VCD_ON",
     "N3XT_LOAD_DELAY",
     "N3XT_STORE_DELAY",
-    "N3XT_NUM_CHANNELS"
+    "N3XT_NUM_CHANNELS",
+    "N3XT_CHANNEL_BYTES_PER_CYCLE"
+  };
+
+  // Passed on to the simulator only if set
+  std::vector<std::string> optionalEnvVariablesToSim = {
+    "SIM_WORKDIR",
+    "SIM_DESC",
+    "STREAM_IN_FILES",
+    "STREAM_IN_FORMAT",
+    "STREAM_IN_WORDS_PER_CYCLE",
+    "STREAM_OUT_FILES",
+    "STREAM_OUT_FORMAT",
+    "STREAM_OUT_WORDS_PER_CYCLE",
+    "WAVE_START",
+    "WAVE_CYCLES",
+    "WAVE_TRIGGER_REG",
+    "WAVE_TRIGGER_VALUE",
+    "WAVE_RING_CYCLES",
+    "DRAMSIM_THREADS"
   };
 
   char* checkAndGetEnvVar(std::string var) {
@@ -135,6 +180,54 @@ class FringeContextVCS : public FringeContextBase<void> {
     return (simCmd*) respChannel->recv();
   }
 
+  // Create and map a memfd of devMemSize bytes; returns false on failure
+  bool mapMemfd(unsigned int flags) {
+    devMemFd = memfdCreate("spatial-devmem", flags);
+    if (devMemFd < 0) return false;
+
+    // hugetlbfs pages are reserved by mmap (no MAP_NORESERVE), so a pool that
+    // is too small fails here instead of with SIGBUS during simulation
+    void *ptr = MAP_FAILED;
+    if (ftruncate(devMemFd, devMemSize) == 0) {
+      int noReserve = (flags & MFD_HUGETLB) ? 0 : MAP_NORESERVE;
+      ptr = mmap(NULL, devMemSize, PROT_READ|PROT_WRITE, MAP_SHARED|noReserve, devMemFd, 0);
+    }
+    if (ptr == MAP_FAILED) {
+      close(devMemFd);
+      devMemFd = -1;
+      return false;
+    }
+    devMem = (uint8_t*) ptr;
+    return true;
+  }
+
+  /**
+   * Create the simulator's device memory as a memfd that both processes map,
+   * so that memcpy is a plain copy on the host instead of a pipe transfer.
+   * Sized and paged like the simulator's own arena (DRAM_ARENA_SIZE_MB,
+   * DRAM_ARENA_HUGEPAGES). Leaves devMem NULL if the kernel has no memfd.
+   */
+  void createSharedDevMem() {
+    const size_t hugePageSize = 2 << 20;
+    long sizeMB = envToLong("DRAM_ARENA_SIZE_MB");
+    if (sizeMB <= 0) sizeMB = 4096;
+    devMemSize = (((size_t)sizeMB << 20) + hugePageSize - 1) & ~(hugePageSize - 1);
+    long hugePages = envToLong("DRAM_ARENA_HUGEPAGES");
+
+    if (hugePages == 2) {
+      if (!mapMemfd(MFD_HUGETLB)) {
+        EPRINTF("Unable to reserve %lu MB of shared hugetlbfs device memory, using regular pages\n", devMemSize >> 20);
+      }
+    }
+    if (!devMem && !mapMemfd(0)) {
+      EPRINTF("Unable to create shared device memory (%s), memcpy will go through the simulator pipe\n", strerror(errno));
+      return;
+    }
+    if (hugePages == 1) {
+      madvise(devMem, devMemSize, MADV_HUGEPAGE);  // Only takes effect if shmem allows transparent hugepages
+    }
+  }
+
 public:
   void step() {
     sendCmd(STEP);
@@ -150,9 +243,43 @@ public:
     }
   }
 
+  /**
+   * Let the simulator clock the design until 'reg' is non-zero, or for at
+   * most 'maxRunCycles' cycles, without a round trip per cycle. Returns the
+   * last value of 'reg' (0 == budget ran out).
+   */
+  uint64_t runUntilDone(uint32_t reg, uint64_t maxRunCycles) {
+    if (initialCycles == -1) getCycles();  // Count cycles from here if nothing else has yet
+
+    simCmd cmd;
+    cmd.id = globalID++;
+    cmd.cmd = RUN_UNTIL_DONE;
+    uint64_t *data = (uint64_t*)cmd.data;
+    data[0] = reg;
+    data[1] = maxRunCycles;
+    cmd.size = 2 * sizeof(uint64_t);
+    cmdChannel->send(&cmd);
+
+    simCmd *resp = recvResp();
+    ASSERT(cmd.id == resp->id, "RUN_UNTIL_DONE resp->id does not match cmd.id!");
+    ASSERT(cmd.cmd == resp->cmd, "RUN_UNTIL_DONE resp->cmd does not match cmd.cmd!");
+    uint64_t status = *(uint64_t*)resp->data;
+    numCycles = getCycles();
+    return status;
+  }
+
   void flushCache(uint32_t kb) {
   }
 
+  // Cycles and status of the last run()
+  uint64_t getNumCycles() {
+    return numCycles;
+  }
+
+  uint32_t getRunStatus() {
+    return runStatus;
+  }
+
   uint64_t getCycles() {
     int id = sendCmd(GET_CYCLES);
     simCmd *resp = recvResp();
@@ -202,8 +329,61 @@ public:
     return rdata;
   }
 
+  // Write 'num' registers with one message per maxRegsPerCmd; the simulator issues one write per cycle
+  virtual void writeRegs(uint32_t num, const uint32_t *regs, const uint64_t *data) {
+    for (uint32_t base = 0; base < num; base += maxRegsPerCmd) {
+      simCmd cmd;
+      cmd.id = globalID++;
+      cmd.cmd = WRITE_REGS;
+      simRegBatch *batch = (simRegBatch*)cmd.data;
+      batch->num = std::min(num - base, maxRegsPerCmd);
+      std::memcpy(batch->regs, regs + base, batch->num * sizeof(uint32_t));
+      std::memcpy(batch->data, data + base, batch->num * sizeof(uint64_t));
+      cmd.size = sizeof(simRegBatch);
+      cmdChannel->send(&cmd);
+    }
+  }
+
+  // Read 'num' registers with one round trip per maxRegsPerCmd; the simulator pipelines the reads
+  virtual void readRegs(uint32_t num, const uint32_t *regs, uint64_t *data) {
+    for (uint32_t base = 0; base < num; base += maxRegsPerCmd) {
+      simCmd cmd;
+      cmd.id = globalID++;
+      cmd.cmd = READ_REGS;
+      simRegBatch *batch = (simRegBatch*)cmd.data;
+      batch->num = std::min(num - base, maxRegsPerCmd);
+      std::memcpy(batch->regs, regs + base, batch->num * sizeof(uint32_t));
+      cmd.size = sizeof(simRegBatch);
+      cmdChannel->send(&cmd);
+
+      simCmd *resp = recvResp();
+      ASSERT(cmd.id == resp->id, "readRegs resp->id does not match cmd.id!");
+      ASSERT(resp->cmd == READ_REGS, "Response from Sim is not READ_REGS");
+      std::memcpy(data + base, ((simRegBatch*)resp->data)->data, batch->num * sizeof(uint64_t));
+    }
+  }
+
+  // Read registers [first, first + num)
+  std::vector<uint64_t> readRegRange(uint32_t first, uint32_t num) {
+    std::vector<uint32_t> regs(num);
+    std::vector<uint64_t> values(num);
+    for (uint32_t i = 0; i < num; i++) regs[i] = first + i;
+    if (num > 0) readRegs(num, &regs[0], &values[0]);
+    return values;
+  }
+
   virtual uint64_t malloc(size_t bytes) {
     size_t safe_bytes = std::max(sizeof(size_t),bytes); // Hack in case malloc is size 0
+    if (!replayAllocs.empty()) {
+      simCheckpointAllocation a = replayAllocs.front();
+      if (a.size == safe_bytes) {
+        replayAllocs.pop_front();
+        replayedBufs[a.addr] = a.size;
+        return a.addr;
+      }
+      EPRINTF("malloc(%lu) does not match the checkpoint's next buffer (%lu bytes), allocating from here on\n", safe_bytes, a.size);
+      replayAllocs.clear();
+    }
     simCmd cmd;
     cmd.id = globalID++;
     cmd.cmd = MALLOC;
@@ -213,7 +393,9 @@ public:
     simCmd *resp = recvResp();
     ASSERT(cmd.id == resp->id, "malloc resp->id does not match cmd.id!");
     ASSERT(cmd.cmd == resp->cmd, "malloc resp->cmd does not match cmd.cmd!");
-    return (uint64_t)(*(uint64_t*)resp->data);
+    uint64_t *data = (uint64_t*)resp->data;
+    if (devMem) devBuffers[data[0]] = std::make_pair(data[1], safe_bytes);
+    return data[0];
   }
 
   virtual void free(uint64_t buf) {
@@ -223,9 +405,44 @@ public:
     std::memcpy(cmd.data, &buf, sizeof(uint64_t));
     cmd.size = sizeof(uint64_t);
     cmdChannel->send(&cmd);
+    devBuffers.erase(buf);
+  }
+
+  /**
+   * Host address of device address 'buf' when device memory is shared with
+   * the simulator, or NULL. Data written there is seen by the design without
+   * a memcpy, and memcpy to or from it copies nothing.
+   */
+  void* getHostPtr(uint64_t buf) {
+    std::map<uint64_t, std::pair<uint64_t, size_t> >::iterator it = devBuffers.upper_bound(buf);
+    if (it == devBuffers.begin()) return NULL;
+    it--;
+    if (buf >= it->first + it->second.second) return NULL;
+    return devMem + it->second.first + (buf - it->first);
+  }
+
+  // Compare host data with device memory restored from a checkpoint
+  bool restoredDataMatches(uint64_t dst, void *src, size_t bytes) {
+    if (bytes == 0) return true;
+    void *restored = getHostPtr(dst);
+    if (restored) return std::memcmp(restored, src, bytes) == 0;
+    std::vector<uint8_t> readBack(bytes);
+    memcpy(&readBack[0], dst, bytes);
+    return std::memcmp(&readBack[0], src, bytes) == 0;
   }
 
   virtual void memcpy(uint64_t dst, void *src, size_t bytes) {
+    // A buffer restored from a checkpoint already holds its data, unless the
+    // host now writes something else: then warn and copy as usual
+    std::map<uint64_t, size_t>::iterator replayed = replayedBufs.upper_bound(dst);
+    if (src && (replayed != replayedBufs.begin())) {
+      replayed--;
+      if (dst + bytes <= replayed->first + replayed->second) {
+        if (restoredDataMatches(dst, src, bytes)) return;
+        EPRINTF("memcpy of %lu bytes to 0x%lx differs from the buffer restored from the checkpoint, copying it\n", bytes, dst);
+      }
+    }
+
     simCmd cmd;
     cmd.id = globalID++;
     cmd.cmd = MEMCPY_H2D;
@@ -237,13 +454,17 @@ public:
     if (src) {
       cmdChannel->send(&cmd);
   
-      // Now send fixed 'bytes' from src
-      cmdChannel->sendFixedBytes(src, bytes);
+      // Now send fixed 'bytes' from src, unless the simulator can take them from shared memory
+      if (!devMem) cmdChannel->sendFixedBytes(src, bytes);
 
-      // Wait for ack
+      // Wait for ack, which carries the destination offset in shared memory
       simCmd *resp = recvResp();
       ASSERT(cmd.id == resp->id, "memcpy resp->id does not match cmd.id!");
-      ASSERT(cmd.cmd == resp->cmd, "memcpy resp->cmd does not match cmd.cmd!");      
+      ASSERT(cmd.cmd == resp->cmd, "memcpy resp->cmd does not match cmd.cmd!");
+      if (devMem) {
+        uint8_t *hostDst = devMem + *(uint64_t*)resp->data;
+        if (hostDst != src) std::memcpy(hostDst, src, bytes);
+      }
     }
   }
 
@@ -259,11 +480,83 @@ public:
     if (dst) {
       cmdChannel->send(&cmd);
 
-      // Now receive fixed 'bytes' from src
-      respChannel->recvFixedBytes(dst, bytes);      
+      if (devMem) {
+        // Copy out of shared memory, at the offset the simulator replies with
+        simCmd *resp = recvResp();
+        ASSERT(cmd.id == resp->id, "memcpy resp->id does not match cmd.id!");
+        ASSERT(cmd.cmd == resp->cmd, "memcpy resp->cmd does not match cmd.cmd!");
+        uint8_t *hostSrc = devMem + *(uint64_t*)resp->data;
+        if (hostSrc != dst) std::memcpy(dst, hostSrc, bytes);
+      } else {
+        // Now receive fixed 'bytes' from src
+        respChannel->recvFixedBytes(dst, bytes);
+      }
     }
   }
 
+  std::string absolutePath(std::string file) {
+    if (file.size() > 0 && file[0] == '/') return file;
+    char cwd[4096];
+    ASSERT(getcwd(cwd, sizeof(cwd)) != NULL, "getcwd failed: %s\n", strerror(errno));
+    return std::string(cwd) + "/" + file;
+  }
+
+  // CHECKPOINT / RESTORE: returns the reply's {status, cycle}
+  std::pair<uint64_t, uint64_t> sendCheckpointCmd(SIM_CMD c, std::string file) {
+    std::string path = absolutePath(file);   // The simulator may run in another directory
+    ASSERT(path.size() < maxSimCmdDataSize, "Checkpoint path %s is too long\n", path.c_str());
+    simCmd cmd;
+    cmd.id = globalID++;
+    cmd.cmd = c;
+    std::memset(cmd.data, 0, maxSimCmdDataSize);
+    std::memcpy(cmd.data, path.c_str(), path.size());
+    cmd.size = path.size() + 1;
+    cmdChannel->send(&cmd);
+    simCmd *resp = recvResp();
+    ASSERT(cmd.id == resp->id, "checkpoint resp->id does not match cmd.id!");
+    ASSERT(cmd.cmd == resp->cmd, "checkpoint resp->cmd does not match cmd.cmd!");
+    uint64_t *data = (uint64_t*)resp->data;
+    return std::make_pair(data[0], data[1]);
+  }
+
+  /**
+   * Save device memory and its buffers to 'file'. The simulator can only
+   * do so when no DRAM request is in flight, so the design is stepped for
+   * up to 'maxWaitCycles' until its requests drain. Returns false if they
+   * did not.
+   */
+  bool checkpoint(std::string file, uint64_t maxWaitCycles = 100000) {
+    for (uint64_t waited = 0; ; waited++) {
+      if (sendCheckpointCmd(CHECKPOINT, file).first != 0) return true;
+      if (waited == maxWaitCycles) return false;
+      step();
+    }
+  }
+
+  /**
+   * Load a checkpoint into a simulator that has not allocated any device
+   * memory yet. Returns the restored buffers, which keep their device
+   * addresses and contents.
+   */
+  std::vector<simCheckpointAllocation> restore(std::string file) {
+    std::pair<uint64_t, uint64_t> resp = sendCheckpointCmd(RESTORE, file);
+
+    std::vector<simCheckpointAllocation> allocations;
+    FILE *f = fopen(file.c_str(), "rb");
+    ASSERT(f != NULL, "Unable to open checkpoint %s: %s\n", file.c_str(), strerror(errno));
+    simCheckpointHeader header;
+    ASSERT(fread(&header, sizeof(header), 1, f) == 1, "Unable to read checkpoint %s\n", file.c_str());
+    allocations.resize(header.numAllocations);
+    ASSERT(header.numAllocations == 0 || fread(&allocations[0], sizeof(simCheckpointAllocation), header.numAllocations, f) == header.numAllocations, "Unable to read checkpoint %s\n", file.c_str());
+    fclose(f);
+
+    for (size_t i = 0; i < allocations.size(); i++) {
+      if (devMem) devBuffers[allocations[i].addr] = std::make_pair(allocations[i].offset, allocations[i].size);
+    }
+    EPRINTF("Restored %lu buffers from checkpoint %s (cycle %lu)\n", allocations.size(), file.c_str(), resp.second);
+    return allocations;
+  }
+
   void connect() {
     int id = sendCmd(READY);
     simCmd *cmd = recvResp();
@@ -273,25 +566,42 @@ public:
   }
 
   FringeContextVCS(std::string path = "") : FringeContextBase(path) {
-    cmdChannel = new Channel(sizeof(simCmd));
-    respChannel = new Channel(sizeof(simCmd));
-
     posix_spawn_file_actions_init(&action);
 
-    // Create cmdPipe (read) handle at SIM_CMD_FD, respPipe (write) handle at SIM_RESP_FD
-    // Close old descriptors after dup2
-    posix_spawn_file_actions_addclose(&action, cmdChannel->writeFd());
-    posix_spawn_file_actions_addclose(&action, respChannel->readFd());
-    posix_spawn_file_actions_adddup2(&action, cmdChannel->readFd(), SIM_CMD_FD);
-    posix_spawn_file_actions_adddup2(&action, respChannel->writeFd(), SIM_RESP_FD);
+    // Talk to the simulator through shared-memory rings handed over at SIM_CHANNEL_FD, or through pipes
+    ShmRing *cmdRing, *respRing;
+    channelFd = createShmRings(channelRingBytes, &cmdRing, &respRing);
+    if (channelFd >= 0) {
+      cmdChannel = new Channel(cmdRing, sizeof(simCmd));
+      respChannel = new Channel(respRing, sizeof(simCmd));
+      posix_spawn_file_actions_adddup2(&action, channelFd, SIM_CHANNEL_FD);
+    } else {
+      EPRINTF("Unable to create shared-memory channel (%s), using pipes\n", strerror(errno));
+      cmdChannel = new Channel(sizeof(simCmd));
+      respChannel = new Channel(sizeof(simCmd));
+
+      // Create cmdPipe (read) handle at SIM_CMD_FD, respPipe (write) handle at SIM_RESP_FD
+      // Close old descriptors after dup2
+      posix_spawn_file_actions_addclose(&action, cmdChannel->writeFd());
+      posix_spawn_file_actions_addclose(&action, respChannel->readFd());
+      posix_spawn_file_actions_adddup2(&action, cmdChannel->readFd(), SIM_CMD_FD);
+      posix_spawn_file_actions_adddup2(&action, respChannel->writeFd(), SIM_RESP_FD);
+    }
+
+    // Hand shared device memory to the simulator at SIM_DEVMEM_FD
+    createSharedDevMem();
+    if (devMem) {
+      posix_spawn_file_actions_adddup2(&action, devMemFd, SIM_DEVMEM_FD);
+    }
 
     std::string argsmem[] = {path};
     char *args[] = {&argsmem[0][0],nullptr};
 
     // Pass required environment variables to simulator
     // Required environment variables must be specified in "envVariablesToSim"
-    char **envs = new char*[envVariablesToSim.size() + 1];
-    std::string *valueStrs = new std::string[envVariablesToSim.size()];
+    size_t maxEnvs = envVariablesToSim.size() + optionalEnvVariablesToSim.size();
+    char **envs = new char*[maxEnvs + 1];
+    std::string *valueStrs = new std::string[maxEnvs];
     int i = 0;
     for (std::vector<std::string>::iterator it = envVariablesToSim.begin(); it != envVariablesToSim.end(); it++) {
       std::string var = *it;
@@ -299,16 +609,29 @@ public:
       envs[i] = &valueStrs[i][0];
       i++;
     }
-    envs[envVariablesToSim.size()] = nullptr;
+    for (std::vector<std::string>::iterator it = optionalEnvVariablesToSim.begin(); it != optionalEnvVariablesToSim.end(); it++) {
+      char *value = getenv(it->c_str());
+      if (value == NULL) continue;
+      valueStrs[i] = *it + "=" + string(value);
+      envs[i] = &valueStrs[i][0];
+      i++;
+    }
+    envs[i] = nullptr;
 
     if(posix_spawnp(&sim_pid, args[0], &action, NULL, &args[0], &envs[0]) != 0) {
       EPRINTF("posix_spawnp failed, error = %s\n", strerror(errno));
       exit(-1);
     }
 
-    // Close Sim side of pipes
-    close(cmdChannel->readFd());
-    close(respChannel->writeFd());
+    // Close Sim side of pipes; the rings stay mapped
+    if (channelFd >= 0) {
+      close(channelFd);
+      cmdChannel->setPeer(sim_pid);
+      respChannel->setPeer(sim_pid);
+    } else {
+      close(cmdChannel->readFd());
+      close(respChannel->writeFd());
+    }
 
     // Connect with simulator
     connect();
@@ -316,7 +639,16 @@ public:
 
     // Configure settings from environment
     debugRegs = envToBool("DEBUG_REGS");
-    long envCycles = atol("MAX_CYCLES");
+    char *restoreFile = getenv("SIM_CHECKPOINT_RESTORE");
+    if (restoreFile != NULL && restoreFile[0] != 0) {
+      std::vector<simCheckpointAllocation> restored = restore(restoreFile);
+      replayAllocs.assign(restored.begin(), restored.end());
+    }
+    char *saveFile = getenv("SIM_CHECKPOINT_SAVE");
+    if (saveFile != NULL && saveFile[0] != 0) {
+      checkpointSaveFile = saveFile;
+    }
+    long envCycles = envToLong("MAX_CYCLES");
     if (envCycles > 0) maxCycles = envCycles;
   }
 
@@ -331,6 +663,14 @@ public:
     // Current assumption is that the design sets arguments individually
     uint32_t status = 0;
 
+    // Device memory is loaded and nothing is in flight yet
+    if (!checkpointSaveFile.empty()) {
+      ASSERT(checkpoint(checkpointSaveFile), "Unable to checkpoint to %s: DRAM requests did not drain\n", checkpointSaveFile.c_str());
+      checkpointSaveFile = "";
+    }
+    replayAllocs.clear();
+    replayedBufs.clear();
+
     // Implement 4-way handshake
     writeReg(statusReg, 0);
     writeReg(commandReg, 2);
@@ -339,10 +679,8 @@ public:
     sleep(0.1);
     writeReg(commandReg, 1);
 
-    while((status == 0) && (numCycles <= maxCycles)) {
-      step();
-      status = readReg(statusReg);
-    }  
+    status = runUntilDone(statusReg, (numCycles < maxCycles) ? maxCycles - numCycles : 0);
+    runStatus = status;
     EPRINTF("Design ran for %lu cycles, status = %u\n", numCycles, status);
     if (status == 0) { // Design did not run to completion
       EPRINTF("=========================================\n");
@@ -417,8 +755,9 @@ public:
     int argOuts = (numArgOuts == 0 & numArgOutInstrs == 0 & numArgEarlyExits == 0) ? 1 : numArgOuts;
     int debugRegStart = 2 + argIns + argOuts + numArgOutInstrs;
     int totalRegs = argIns + argOuts + numArgOutInstrs + numArgEarlyExits + 2 + NUM_DEBUG_SIGNALS;
+    std::vector<uint64_t> values = readRegRange(0, totalRegs);
     for (int i=0; i<totalRegs; i++) {
-      uint32_t value = readReg(i);
+      uint32_t value = values[i];
       if (i < debugRegStart) {
         if (i == 0) EPRINTF(" ******* Non-debug regs *******\n");
         EPRINTF("\tR%d: %08x (%08d)\n", i, value, value);
@@ -434,8 +773,9 @@ public:
     int argOuts = (numArgOuts == 0 & numArgOutInstrs == 0 & numArgEarlyExits == 0) ? 1 : numArgOuts;
     int debugRegStart = 2 + argIns + argOuts + numArgOutInstrs + numArgEarlyExits;
 
+    std::vector<uint64_t> values = readRegRange(0, debugRegStart);
     for (int i=0; i<debugRegStart; i++) {
-      uint64_t value = readReg(i);
+      uint64_t value = values[i];
       if (i < debugRegStart) {
         if (i == 0) EPRINTF(" ******* Non-debug regs *******\n");
         EPRINTF("\tR%d: %016lx (%08lu)\n", i, value, value);
@@ -447,9 +787,10 @@ public:
     EPRINTF(" ******* Debug regs *******\n");
     int argInOffset = numArgIns == 0 ? 1 : numArgIns;
     int argOutOffset = (numArgOuts == 0 & numArgOutInstrs == 0 & numArgEarlyExits == 0) ? 1 : numArgOuts;
+    std::vector<uint64_t> values = readRegRange(argInOffset + argOutOffset + numArgOutInstrs + numArgEarlyExits + 2 - numArgIOs, NUM_DEBUG_SIGNALS);
     for (int i=0; i<NUM_DEBUG_SIGNALS; i++) {
       if (i % 16 == 0) EPRINTF("\n");
-      uint64_t value = readReg(argInOffset + argOutOffset + numArgOutInstrs + numArgEarlyExits + 2 - numArgIOs + i);
+      uint64_t value = values[i];
       EPRINTF("\t%s: %08x (%08d)\n", signalLabels[i], value, value);
     }
     EPRINTF(" **************************\n");
@@ -460,6 +801,10 @@ public:
       dumpAllRegs();
     }
     finish();
+    if (devMem) {
+      munmap(devMem, devMemSize);
+      close(devMemFd);
+    }
   }
 };
 
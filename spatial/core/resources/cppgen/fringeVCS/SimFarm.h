@@ -0,0 +1,299 @@
+#ifndef __SIM_FARM_H__
+#define __SIM_FARM_H__
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "FringeContextVCS.h"
+
+/**
+ * One simulation of a sweep: a name, environment overrides applied before
+ * its simulator is spawned (N3XT_*, DRAM_*, DRAMSIM_HOME to pick other
+ * DRAMSim2 ini files, ...), and the directory that simulator runs in.
+ * Only variables listed in FringeContextVCS::envVariablesToSim or
+ * optionalEnvVariablesToSim reach the simulator; all of them are visible
+ * to the host side of the job.
+ */
+struct SimJob {
+  std::string name;
+  std::map<std::string, std::string> env;
+  std::string workDir;    // "" == <farm directory>/<name>
+};
+
+struct SimJobResult {
+  int exitCode = -1;      // Of the job's host process; -1 == did not exit normally
+  uint32_t status = 0;    // Status register at the end of run(), 0 == did not finish
+  uint64_t cycles = 0;
+  double seconds = 0;
+};
+
+/**
+ * Simulation farm: runs many jobs against the same simulator binary, at
+ * most 'maxParallel' at a time.
+ * Every job is a forked copy of the host driver with its own
+ * FringeContextVCS, so it has its own simulator, channels and device
+ * memory, and a crashing job cannot take the others down. The job's host
+ * output and its simulator's output go to <workDir>/sim.log, and the
+ * simulator's traces and stream files are relative to <workDir>.
+ * When all jobs are done, the farm writes <farm directory>/summary.csv
+ * (one row per job) and stats.txt (every job's stat files, concatenated).
+ *
+ *   SimFarm farm("./verilog/accel.bit.bin");
+ *   farm.addJobsFromFile("sweep.txt");
+ *   farm.addSharedFile("in.txt");
+ *   farm.addStatFile("out.txt");
+ *   farm.run([&](FringeContextVCS *c, const SimJob &job) { Application(c); });
+ */
+class SimFarm {
+  std::string simPath;
+  std::string farmDir;
+  int maxParallel;
+  std::vector<std::string> statFiles;
+  std::vector<std::string> sharedFiles;   // Absolute paths
+
+  struct RunningJob {
+    size_t index;
+    int resultFd;
+    std::chrono::steady_clock::time_point start;
+  };
+
+  static std::string absolutePath(const std::string &path) {
+    char buf[PATH_MAX];
+    if (realpath(path.c_str(), buf) != NULL) return std::string(buf);
+    if (path.size() > 0 && path[0] == '/') return path;
+    ASSERT(getcwd(buf, sizeof(buf)) != NULL, "[SimFarm] getcwd failed: %s\n", strerror(errno));
+    return std::string(buf) + "/" + path;
+  }
+
+  static void makeDirs(const std::string &path) {
+    for (size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1)) {
+      std::string dir = path.substr(0, pos);
+      ASSERT(mkdir(dir.c_str(), 0755) == 0 || errno == EEXIST, "[SimFarm] Unable to create %s: %s\n", dir.c_str(), strerror(errno));
+      if (pos == std::string::npos) break;
+    }
+  }
+
+  // Runs in the forked job process; never returns
+  void runJob(const SimJob &job, int resultFd, std::function<void(FringeContextVCS*, const SimJob&)> &body) {
+    int log = open((job.workDir + "/sim.log").c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if (log >= 0) {
+      dup2(log, STDOUT_FILENO);
+      dup2(log, STDERR_FILENO);
+      close(log);
+    }
+    for (std::map<std::string, std::string>::const_iterator it = job.env.begin(); it != job.env.end(); it++) {
+      setenv(it->first.c_str(), it->second.c_str(), 1);
+    }
+    setenv("SIM_WORKDIR", job.workDir.c_str(), 1);
+    if (job.env.find("SIM_DESC") == job.env.end()) {
+      setenv("SIM_DESC", job.name.c_str(), 1);   // Keeps DRAMSim2's .vis files of different jobs apart
+    }
+    EPRINTF("[SimFarm] Job %s\n", job.name.c_str());
+
+    FringeContextVCS *c = new FringeContextVCS(simPath);
+    body(c, job);
+    SimJobResult result;
+    result.exitCode = 0;
+    result.status = c->getRunStatus();
+    result.cycles = c->getNumCycles();
+    delete c;
+
+    ASSERT(write(resultFd, &result, sizeof(result)) == sizeof(result), "[SimFarm] Unable to report result: %s\n", strerror(errno));
+    fflush(stdout);
+    fflush(stderr);
+    _exit(0);
+  }
+
+  void launch(size_t index, std::function<void(FringeContextVCS*, const SimJob&)> &body, std::map<pid_t, RunningJob> &running) {
+    SimJob &job = jobs[index];
+    if (job.workDir.empty()) job.workDir = farmDir + "/" + job.name;
+    job.workDir = absolutePath(job.workDir);
+    makeDirs(job.workDir);
+    for (size_t i = 0; i < sharedFiles.size(); i++) {
+      std::string link = job.workDir + "/" + sharedFiles[i].substr(sharedFiles[i].rfind('/') + 1);
+      unlink(link.c_str());
+      ASSERT(symlink(sharedFiles[i].c_str(), link.c_str()) == 0, "[SimFarm] Unable to link %s: %s\n", link.c_str(), strerror(errno));
+    }
+
+    int fds[2];
+    ASSERT(pipe(fds) == 0, "[SimFarm] pipe failed: %s\n", strerror(errno));
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    ASSERT(pid >= 0, "[SimFarm] fork failed: %s\n", strerror(errno));
+    if (pid == 0) {
+      close(fds[0]);
+      runJob(job, fds[1], body);
+    }
+    close(fds[1]);
+    RunningJob r;
+    r.index = index;
+    r.resultFd = fds[0];
+    r.start = std::chrono::steady_clock::now();
+    running[pid] = r;
+  }
+
+  void finish(pid_t pid, int waitStatus, std::map<pid_t, RunningJob> &running) {
+    RunningJob &r = running[pid];
+    SimJobResult &result = results[r.index];
+    if (read(r.resultFd, &result, sizeof(result)) != sizeof(result)) {
+      result = SimJobResult();
+    }
+    close(r.resultFd);
+    if (!WIFEXITED(waitStatus)) {
+      result.exitCode = -1;
+    } else if (WEXITSTATUS(waitStatus) != 0) {
+      result.exitCode = WEXITSTATUS(waitStatus);
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - r.start).count();
+    EPRINTF("[SimFarm] %s: exit %d, status %u, %lu cycles, %.1f s\n", jobs[r.index].name.c_str(), result.exitCode, result.status, result.cycles, result.seconds);
+    running.erase(pid);
+  }
+
+public:
+  std::vector<SimJob> jobs;
+  std::vector<SimJobResult> results;
+
+  /**
+   * 'parallel' <= 0 takes FARM_PARALLEL from the environment, or else the
+   * number of CPUs. Each job keeps about one CPU busy with its simulator.
+   */
+  SimFarm(std::string path, std::string dir = "farm", int parallel = 0) {
+    simPath = absolutePath(path);
+    farmDir = absolutePath(dir);
+    maxParallel = parallel;
+    if (maxParallel <= 0) {
+      char *parallelVar = getenv("FARM_PARALLEL");
+      if (parallelVar != NULL) {
+        if (parallelVar[0] != 0 && atoi(parallelVar) > 0) {
+          maxParallel = atoi(parallelVar);
+        }
+      }
+    }
+    if (maxParallel <= 0) maxParallel = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (maxParallel <= 0) maxParallel = 1;
+  }
+
+  void addJob(std::string name, std::map<std::string, std::string> env = {}, std::string workDir = "") {
+    SimJob job;
+    job.name = name;
+    job.env = env;
+    job.workDir = workDir;
+    jobs.push_back(job);
+  }
+
+  /**
+   * One job per line: a name, then VAR=value overrides. 'workDir=<dir>'
+   * sets the job's directory. Blank lines and lines starting with '#' are
+   * skipped.
+   *   ddr3_4ch   N3XT_NUM_CHANNELS=4  DRAMSIM_HOME=/sweep/ddr3
+   *   ideal      USE_IDEAL_DRAM=1     workDir=/tmp/ideal
+   */
+  void addJobsFromFile(std::string file) {
+    std::ifstream in(file.c_str());
+    ASSERT(in.is_open(), "[SimFarm] Unable to open job file %s\n", file.c_str());
+    std::string line;
+    while (std::getline(in, line)) {
+      std::istringstream words(line);
+      std::string name, word, workDir;
+      if (!(words >> name) || name[0] == '#') continue;
+      std::map<std::string, std::string> env;
+      while (words >> word) {
+        size_t eq = word.find('=');
+        ASSERT(eq != std::string::npos && eq > 0, "[SimFarm] Expected VAR=value in job %s, got '%s'\n", name.c_str(), word.c_str());
+        if (word.substr(0, eq) == "workDir") {
+          workDir = word.substr(eq + 1);
+        } else {
+          env[word.substr(0, eq)] = word.substr(eq + 1);
+        }
+      }
+      addJob(name, env, workDir);
+    }
+  }
+
+  // An input file (in.txt, ...) to link into every job's directory under its own name
+  void addSharedFile(std::string file) {
+    sharedFiles.push_back(absolutePath(file));
+  }
+
+  // A file, relative to each job's directory, to collect into stats.txt
+  void addStatFile(std::string file) {
+    statFiles.push_back(file);
+  }
+
+  /**
+   * Run every job through 'body', which gets a connected FringeContextVCS
+   * and drives the application on it (load, setArg, run, ...). Returns the
+   * number of jobs that failed: exited abnormally or did not finish.
+   */
+  int run(std::function<void(FringeContextVCS*, const SimJob&)> body) {
+    makeDirs(farmDir);
+    results.assign(jobs.size(), SimJobResult());
+    EPRINTF("[SimFarm] %lu jobs, %d at a time\n", jobs.size(), maxParallel);
+
+    std::map<pid_t, RunningJob> running;
+    size_t next = 0;
+    while (next < jobs.size() || !running.empty()) {
+      while (next < jobs.size() && (int)running.size() < maxParallel) {
+        launch(next++, body, running);
+      }
+      int waitStatus;
+      pid_t pid = waitpid(-1, &waitStatus, 0);
+      if (pid < 0) {
+        ASSERT(errno == EINTR, "[SimFarm] waitpid failed: %s\n", strerror(errno));
+        continue;
+      }
+      if (running.find(pid) != running.end()) {
+        finish(pid, waitStatus, running);
+      }
+    }
+
+    writeSummary();
+    int failed = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+      if (results[i].exitCode != 0 || results[i].status == 0) failed++;
+    }
+    return failed;
+  }
+
+  void writeSummary() {
+    std::string csvPath = farmDir + "/summary.csv";
+    FILE *csv = fopen(csvPath.c_str(), "w");
+    ASSERT(csv != NULL, "[SimFarm] Unable to write %s: %s\n", csvPath.c_str(), strerror(errno));
+    fprintf(csv, "name,exit,status,cycles,seconds,workDir\n");
+    for (size_t i = 0; i < jobs.size(); i++) {
+      fprintf(csv, "%s,%d,%u,%lu,%.3f,%s\n", jobs[i].name.c_str(), results[i].exitCode, results[i].status, results[i].cycles, results[i].seconds, jobs[i].workDir.c_str());
+    }
+    fclose(csv);
+
+    std::string statsPath = farmDir + "/stats.txt";
+    std::ofstream stats(statsPath.c_str());
+    for (size_t i = 0; i < jobs.size(); i++) {
+      for (size_t f = 0; f < statFiles.size(); f++) {
+        std::string path = jobs[i].workDir + "/" + statFiles[f];
+        std::ifstream in(path.c_str());
+        stats << "==== " << jobs[i].name << ": " << statFiles[f] << " ====\n";
+        if (in.is_open()) {
+          stats << in.rdbuf() << "\n";
+        } else {
+          stats << "(missing)\n";
+        }
+      }
+    }
+    EPRINTF("[SimFarm] Summary in %s\n", csvPath.c_str());
+  }
+};
+
+#endif
@@ -9,12 +9,19 @@
 #include <stdint.h>
 #include <assert.h>
 #include "commonDefs.h"
+#include "shmRing.h"
 
 #define READ 0
 #define WRITE 1
 
+/**
+ * Message channel between the host and the simulator: a pipe, or one
+ * direction of a shared-memory ring (see shmRing.h) when both sides have
+ * mapped one.
+ */
 class Channel {
-  int pipeFd[2];
+  int pipeFd[2] = {-1, -1};
+  ShmRingPort *ring = NULL;
   uint8_t *buf;
   int bufSize = -1;
 public:
@@ -38,6 +45,19 @@ public:
     this->bufSize = bufSize;
   }
 
+  Channel(ShmRing *shmRing, int bufSize) {
+    ring = new ShmRingPort(shmRing);
+
+    buf = (uint8_t*) malloc(bufSize);
+    memset(buf, 0, bufSize);
+    this->bufSize = bufSize;
+  }
+
+  // Process on the other end of a ring, so that waiting for it notices if it exits
+  void setPeer(pid_t pid) {
+    if (ring) ring->setPeer(pid);
+  }
+
   int writeFd() {
     return pipeFd[WRITE];
   }
@@ -47,6 +67,10 @@ public:
   }
 
   void send(void *cmd) {
+    if (ring) {
+      ring->write(cmd, bufSize);
+      return;
+    }
     int bytes = write(pipeFd[WRITE], cmd, bufSize);
     if (bytes < 0) {
       EPRINTF("Error sending cmd, error = %s\n", strerror(errno));
@@ -56,6 +80,10 @@ public:
 
   void sendFixedBytes(void *src, size_t numBytes) {
     ASSERT(src, "[sendFixedBytes] Src memory is null\n");
+    if (ring) {
+      ring->write(src, numBytes);
+      return;
+    }
     uint8_t *bsrc = (uint8_t*)src;
     std::vector<pollfd> plist = { {pipeFd[WRITE], POLLOUT} };
     size_t totalBytesWritten = 0;
@@ -67,7 +95,6 @@ public:
           EPRINTF("send error: %s\n", strerror(errno));
         } else {
           totalBytesWritten += bytesWritten;
-          EPRINTF("Total bytes written: %lu\n", totalBytesWritten);
         }
 
         if (totalBytesWritten >= numBytes) {
@@ -80,6 +107,10 @@ public:
   }
 
 	void* recv() {
+    if (ring) {
+      ring->read(buf, bufSize);
+      return (void*)buf;
+    }
     memset(buf, 0, bufSize);
 
     std::vector<pollfd> plist = { {pipeFd[READ], POLLIN} };
@@ -99,6 +130,10 @@ public:
 
   void recvFixedBytes(void *dst, size_t numBytes) {
     ASSERT(dst, "[recvFixedBytes] Destination memory is null\n");
+    if (ring) {
+      ring->read(dst, numBytes);
+      return;
+    }
     uint8_t *bdst = (uint8_t*)dst;
     std::vector<pollfd> plist = { {pipeFd[READ], POLLIN} };
     size_t totalBytesRead = 0;
@@ -110,7 +145,6 @@ public:
           EPRINTF("recvFixedBytes error @totalBytesRead = %lu, &bdst = %p: %s\n", totalBytesRead, (void*)&bdst[totalBytesRead], strerror(errno));
         } else {
           totalBytesRead += bytesRead;
-          EPRINTF("Total bytes read: %lu\n", totalBytesRead);
         }
         if (totalBytesRead >= numBytes) {
           break;
@@ -0,0 +1,233 @@
+#ifndef __SHM_RING_H
+#define __SHM_RING_H
+
+#include <new>
+#include <atomic>
+#include <climits>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "commonDefs.h"
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+#ifndef MFD_HUGETLB
+#define MFD_HUGETLB 0x0004U
+#endif
+
+// Anonymous shared memory file, inherited by the simulator; -1 (and errno) on failure
+int memfdCreate(const char *name, unsigned int flags) {
+#ifdef SYS_memfd_create
+  return syscall(SYS_memfd_create, name, MFD_CLOEXEC | flags);
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+/**
+ * Single-producer single-consumer byte ring in shared memory
+ * 'head' and 'tail' count the bytes consumed and produced so far, each on
+ * its own cache line. A side that finds the ring empty (or full) spins for
+ * a while, then sleeps on a futex: the other side bumps tailSeq (headSeq)
+ * every time it publishes, and only makes the wake syscall when the waiting
+ * flag says that someone is asleep.
+ */
+struct ShmRing {
+  alignas(64) std::atomic<uint64_t> head;
+  std::atomic<uint32_t> headSeq;
+  std::atomic<uint32_t> producerWaiting;
+  alignas(64) std::atomic<uint64_t> tail;
+  std::atomic<uint32_t> tailSeq;
+  std::atomic<uint32_t> consumerWaiting;
+  alignas(64) uint64_t capacity;   // Bytes, a power of two
+
+  ShmRing(uint64_t capacity) : head(0), headSeq(0), producerWaiting(0), tail(0), tailSeq(0), consumerWaiting(0), capacity(capacity) {
+  }
+
+  uint8_t* data() {
+    return (uint8_t*)(this + 1);
+  }
+};
+
+/**
+ * One side (producer or consumer) of a ShmRing
+ * The number of spins before sleeping adapts: it doubles every time the
+ * other side answered while we were spinning, and halves every time we had
+ * to sleep. There is no spinning at all on a single CPU.
+ */
+class ShmRingPort {
+  static const uint32_t minSpin = 16;
+  static const uint32_t maxSpin = 4096;
+
+  ShmRing *ring;
+  uint64_t mask;
+  uint32_t spinLimit;
+  uint32_t spinCeiling;
+  pid_t peer = 0;   // Process on the other side, checked while sleeping; 0 == unknown
+
+  static void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+  }
+
+  static void futexWait(std::atomic<uint32_t> *seq, uint32_t expected, const struct timespec *timeout) {
+    syscall(SYS_futex, (uint32_t*)seq, FUTEX_WAIT, expected, timeout, NULL, 0);
+  }
+
+  static void futexWake(std::atomic<uint32_t> *seq) {
+    syscall(SYS_futex, (uint32_t*)seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+  }
+
+  bool peerAlive() {
+    if (peer <= 0) return true;
+    if (getppid() == peer) return true;   // Peer is our parent
+    return waitpid(peer, NULL, WNOHANG) == 0;   // Peer is our child
+  }
+
+  // Make new head / tail visible, then wake the other side if it is asleep
+  void publish(std::atomic<uint32_t> &seq, std::atomic<uint32_t> &waiting) {
+    seq.fetch_add(1, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting.load(std::memory_order_relaxed)) {
+      futexWake(&seq);
+    }
+  }
+
+  template <class F>
+  void waitUntil(std::atomic<uint32_t> &seq, std::atomic<uint32_t> &waiting, F ready) {
+    for (uint32_t i = 0; i < spinLimit; i++) {
+      if (ready()) {
+        spinLimit = (2 * spinLimit < spinCeiling) ? 2 * spinLimit : spinCeiling;
+        return;
+      }
+      cpuRelax();
+    }
+
+    const struct timespec timeout = {1, 0};
+    while (true) {
+      uint32_t s = seq.load(std::memory_order_acquire);
+      if (ready()) break;
+      waiting.store(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (!ready()) {
+        futexWait(&seq, s, &timeout);
+      }
+      waiting.store(0, std::memory_order_relaxed);
+      if (!ready() && !peerAlive()) {
+        EPRINTF("[ShmRing] Peer process %d exited\n", peer);
+        exit(-1);
+      }
+    }
+    spinLimit = (spinLimit / 2 > minSpin) ? spinLimit / 2 : ((spinCeiling > 0) ? minSpin : 0);
+  }
+
+public:
+  ShmRingPort(ShmRing *ring) : ring(ring) {
+    mask = ring->capacity - 1;
+    spinCeiling = (sysconf(_SC_NPROCESSORS_ONLN) > 1) ? maxSpin : 0;
+    spinLimit = spinCeiling;
+  }
+
+  void setPeer(pid_t pid) {
+    peer = pid;
+  }
+
+  // Producer: blocks until all 'numBytes' are in the ring
+  void write(const void *src, size_t numBytes) {
+    const uint8_t *bsrc = (const uint8_t*)src;
+    uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+    while (numBytes > 0) {
+      uint64_t space = ring->capacity - (tail - ring->head.load(std::memory_order_acquire));
+      if (space == 0) {
+        waitUntil(ring->headSeq, ring->producerWaiting, [&]() { return ring->head.load(std::memory_order_acquire) + ring->capacity > tail; });
+        continue;
+      }
+      size_t chunk = (numBytes < space) ? numBytes : space;
+      uint64_t offset = tail & mask;
+      size_t first = (chunk < ring->capacity - offset) ? chunk : ring->capacity - offset;
+      memcpy(ring->data() + offset, bsrc, first);
+      memcpy(ring->data(), bsrc + first, chunk - first);
+      tail += chunk;
+      bsrc += chunk;
+      numBytes -= chunk;
+      ring->tail.store(tail, std::memory_order_release);
+      publish(ring->tailSeq, ring->consumerWaiting);
+    }
+  }
+
+  // Consumer: blocks until 'numBytes' have been read
+  void read(void *dst, size_t numBytes) {
+    uint8_t *bdst = (uint8_t*)dst;
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    while (numBytes > 0) {
+      uint64_t avail = ring->tail.load(std::memory_order_acquire) - head;
+      if (avail == 0) {
+        waitUntil(ring->tailSeq, ring->consumerWaiting, [&]() { return ring->tail.load(std::memory_order_acquire) != head; });
+        continue;
+      }
+      size_t chunk = (numBytes < avail) ? numBytes : avail;
+      uint64_t offset = head & mask;
+      size_t first = (chunk < ring->capacity - offset) ? chunk : ring->capacity - offset;
+      memcpy(bdst, ring->data() + offset, first);
+      memcpy(bdst + first, ring->data(), chunk - first);
+      head += chunk;
+      bdst += chunk;
+      numBytes -= chunk;
+      ring->head.store(head, std::memory_order_release);
+      publish(ring->headSeq, ring->producerWaiting);
+    }
+  }
+};
+
+/**
+ * The host and the simulator share one file holding two rings: commands
+ * (host -> sim) followed by responses (sim -> host), each 'capacity' bytes.
+ */
+size_t shmRingsSize(uint64_t capacity) {
+  return 2 * (sizeof(ShmRing) + capacity);
+}
+
+// Map the rings in 'fd', initializing them if 'capacity' is nonzero; false if 'fd' is not open or cannot be mapped
+bool mapShmRings(int fd, uint64_t capacity, ShmRing **cmdRing, ShmRing **respRing) {
+  struct stat st;
+  if (fstat(fd, &st) != 0) return false;
+  size_t size = (capacity > 0) ? shmRingsSize(capacity) : (size_t)st.st_size;
+  void *ptr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  if (ptr == MAP_FAILED) return false;
+
+  uint8_t *base = (uint8_t*) ptr;
+  if (capacity > 0) {
+    ASSERT((capacity & (capacity - 1)) == 0, "[ShmRing] Capacity %lu is not a power of two\n", capacity);
+    *cmdRing = new (base) ShmRing(capacity);
+    *respRing = new (base + sizeof(ShmRing) + capacity) ShmRing(capacity);
+  } else {
+    *cmdRing = (ShmRing*) base;
+    *respRing = (ShmRing*) (base + sizeof(ShmRing) + (*cmdRing)->capacity);
+  }
+  return true;
+}
+
+// Create and map the rings for a new simulator; returns the file to hand over, or -1
+int createShmRings(uint64_t capacity, ShmRing **cmdRing, ShmRing **respRing) {
+  int fd = memfdCreate("spatial-channel", 0);
+  if (fd < 0) return -1;
+  if ((ftruncate(fd, shmRingsSize(capacity)) != 0) || !mapShmRings(fd, capacity, cmdRing, respRing)) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+#endif // __SHM_RING_H
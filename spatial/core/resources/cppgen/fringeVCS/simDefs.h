@@ -14,8 +14,18 @@
 #define SIM_CMD_FD    1000
 #define SIM_RESP_FD   1001
 
+// Shared device memory file descriptor: the simulator's DRAM arena, also mapped by the host
+#define SIM_DEVMEM_FD 1002
+
+// Shared-memory rings that replace the CMD and RESP pipes, if the host created them
+#define SIM_CHANNEL_FD 1003
+
 // Simulation commands
-enum SIM_CMD { RESET, READY, START, STEP, GET_CYCLES, WRITE_REG, READ_REG, MALLOC, MEMCPY_H2D, MEMCPY_D2H, FREE, FIN };
+// RUN_UNTIL_DONE: the simulator clocks the design by itself until a register
+// (data[0]) is non-zero or a cycle budget (data[1]) runs out, then replies once
+// READ_REGS / WRITE_REGS: up to maxRegsPerCmd registers in one simRegBatch
+// CHECKPOINT / RESTORE: save / load device memory to / from a file (data, NUL-terminated path)
+enum SIM_CMD { RESET, READY, START, STEP, GET_CYCLES, WRITE_REG, READ_REG, MALLOC, MEMCPY_H2D, MEMCPY_D2H, FREE, FIN, RUN_UNTIL_DONE, READ_REGS, WRITE_REGS, CHECKPOINT, RESTORE };
 
 const uint64_t maxSimCmdDataSize = 1024;
 struct simCmd {
@@ -25,6 +35,29 @@ struct simCmd {
   uint64_t size;
 };
 
+// Data of READ_REGS / WRITE_REGS commands, and of READ_REGS responses (filled-in values)
+const uint32_t maxRegsPerCmd = 64;
+struct simRegBatch {
+  uint32_t num;
+  uint32_t regs[maxRegsPerCmd];
+  uint64_t data[maxRegsPerCmd];
+};
+static_assert(sizeof(simRegBatch) <= maxSimCmdDataSize, "simRegBatch does not fit in a simCmd");
+
+// Checkpoint files start with a simCheckpointHeader and one simCheckpointAllocation
+// per live device buffer; the simulator's own state follows
+const char simCheckpointMagic[8] = "SPCKPT1";
+struct simCheckpointHeader {
+  char magic[8];
+  uint64_t cycles;          // When the checkpoint was taken
+  uint64_t numAllocations;
+};
+struct simCheckpointAllocation {
+  uint64_t addr;            // Device address returned by MALLOC
+  uint64_t offset;          // In the device memory arena
+  uint64_t size;
+};
+
 typedef struct simCmd simCmd;
 
 void printPkt(simCmd *cmd) {
@@ -67,7 +67,6 @@ public:
           EPRINTF("send error: %s\n", strerror(errno));
         } else {
           totalBytesWritten += bytesWritten;
-          EPRINTF("Total bytes written: %lu\n", totalBytesWritten);
         }
 
         if (totalBytesWritten >= numBytes) {
@@ -110,7 +109,6 @@ public:
           EPRINTF("recvFixedBytes error @totalBytesRead = %lu, &bdst = %p: %s\n", totalBytesRead, (void*)&bdst[totalBytesRead], strerror(errno));
         } else {
           totalBytesRead += bytesRead;
-          EPRINTF("Total bytes read: %lu\n", totalBytesRead);
         }
         if (totalBytesRead >= numBytes) {
           break;